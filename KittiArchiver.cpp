@@ -0,0 +1,181 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+/*
+ * Packs the Velodyne scans of KITTI data sets into one KittiSequenceArchive
+ * per drive, which the visualizer and the benchmark then read instead of the
+ * .bin files.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/program_options.hpp>
+
+#include "KittiConfig.h"
+#include "KittiDataset.h"
+#include "KittiPointFrame.h"
+#include "KittiSequenceArchive.h"
+
+namespace
+{
+
+float getMaximumError(const float* a, const float* b, std::size_t size)
+{
+    float error = 0.0f;
+    for (std::size_t i = 0; i < size; ++i)
+        error = std::max(error, std::fabs(a[i] - b[i]));
+    return error;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    boost::program_options::options_description desc("Program options");
+    desc.add_options()
+        ("help", "Produce this help message.")
+        ("data-directory", boost::program_options::value<std::string>(), "Set the folder containing the KITTI raw data sets.")
+        ("rescan", "Search the data directory for data sets even if a manifest exists.")
+        ("dataset", boost::program_options::value<std::vector<int> >()->multitoken(), "Set the KITTI data sets to pack by drive number, plus 10000 for each earlier recording date if there are several (default: all available).")
+        ("overwrite", "Replace existing archives (default: skip their data sets).")
+        ("compress", "Also compress the quantized frames losslessly, they are decoded on several threads.")
+    ;
+
+    boost::program_options::variables_map vm;
+    try
+    {
+        boost::program_options::store(boost::program_options::parse_command_line(argc, argv, desc), vm);
+        boost::program_options::notify(vm);
+    }
+    catch (const boost::program_options::error& e)
+    {
+        std::cerr << e.what() << std::endl << desc << std::endl;
+        return 1;
+    }
+
+    if (vm.count("help")) {
+        std::cout << desc << std::endl;
+        return 1;
+    }
+
+    if (vm.count("data-directory")) {
+        KittiConfig::setDataDirectory(vm["data-directory"].as<std::string>());
+    }
+    if (!KittiConfig::initAvailableDatasets(vm.count("rescan") > 0)) {
+        return 1;
+    }
+
+    std::vector<int> datasets = KittiConfig::availableDatasets;
+    if (vm.count("dataset")) {
+        datasets = vm["dataset"].as<std::vector<int> >();
+    }
+    bool overwrite = vm.count("overwrite") > 0;
+    KittiSequenceArchive::Encoding encoding = vm.count("compress") ? KittiSequenceArchive::DELTA_VARINT
+                                                                  : KittiSequenceArchive::PLAIN;
+
+    // The archives are written from the .bin files
+    KittiConfig::setSequenceArchiveEnabled(false);
+
+    int failures = 0;
+    KittiPointFrame pointFrame;
+    KittiPointFrame archivedFrame;
+    for (std::size_t d = 0; d < datasets.size(); ++d)
+    {
+        boost::filesystem::path archivePath = KittiConfig::getSequenceArchivePath(datasets[d]);
+        boost::system::error_code error;
+        if (!overwrite && boost::filesystem::exists(archivePath, error))
+        {
+            std::cout << "Skipping data set " << datasets[d] << ", " << archivePath.string()
+                      << " exists." << std::endl;
+            continue;
+        }
+
+        KittiDataset dataset(datasets[d]);
+        int numberOfFrames = dataset.getNumberOfFrames();
+        if (numberOfFrames == 0)
+        {
+            failures++;
+            continue;
+        }
+
+        KittiSequenceArchiveWriter writer;
+        if (!writer.open(archivePath, numberOfFrames, encoding))
+        {
+            std::cerr << "Could not create " << archivePath.string() << "." << std::endl;
+            failures++;
+            continue;
+        }
+
+        std::cout << "Packing " << numberOfFrames << " frames of data set " << datasets[d] << std::endl;
+        boost::uint64_t pointBytes = 0;
+        bool written = true;
+        for (int frameId = 0; frameId < numberOfFrames && written; ++frameId)
+        {
+            // Missing scans stay missing in the archive
+            if (!dataset.getPointFrame(frameId, pointFrame))
+                continue;
+            pointBytes += pointFrame.size() * 4 * sizeof(float);
+            written = writer.addFrame(frameId, pointFrame);
+        }
+        if (!written || !writer.close())
+        {
+            std::cerr << "Could not write " << archivePath.string() << "." << std::endl;
+            failures++;
+            continue;
+        }
+
+        // Read the archive back to report the quantization error
+        KittiSequenceArchive archive;
+        if (!archive.open(archivePath))
+        {
+            failures++;
+            continue;
+        }
+        float positionError = 0.0f;
+        float intensityError = 0.0f;
+        for (int frameId = 0; frameId < numberOfFrames; ++frameId)
+        {
+            bool original = dataset.getPointFrame(frameId, pointFrame);
+            bool archived = archive.readFrame(frameId, archivedFrame);
+            if (original != archived || pointFrame.size() != archivedFrame.size())
+            {
+                std::cerr << "Frame " << frameId << " differs in " << archivePath.string() << "." << std::endl;
+                failures++;
+                break;
+            }
+            std::size_t size = pointFrame.size();
+            positionError = std::max(positionError, getMaximumError(pointFrame.x(), archivedFrame.x(), size));
+            positionError = std::max(positionError, getMaximumError(pointFrame.y(), archivedFrame.y(), size));
+            positionError = std::max(positionError, getMaximumError(pointFrame.z(), archivedFrame.z(), size));
+            intensityError = std::max(intensityError,
+                                      getMaximumError(pointFrame.intensity(), archivedFrame.intensity(), size));
+        }
+
+        std::cout << "Wrote " << archivePath.string() << ": "
+                  << writer.getSize() / (1024.0 * 1024.0) << " MB for "
+                  << pointBytes / (1024.0 * 1024.0) << " MB of points, maximum error "
+                  << positionError * 1000.0f << " mm, " << intensityError << " reflectance" << std::endl;
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,426 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+/*
+ * Replays KITTI data sets through the loading and cropping code of the
+ * visualizer without a display and reports the throughput of each stage.
+ */
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <boost/program_options.hpp>
+
+#include "KittiBoxKernel.h"
+#include "KittiColorMap.h"
+#include "KittiConfig.h"
+#include "KittiDataset.h"
+#include "KittiProjectionKernel.h"
+#include "KittiTiming.h"
+#include "KittiVoxelGrid.h"
+
+namespace
+{
+
+/*
+ * Counts the heap allocations. With glibc, malloc itself is replaced, which
+ * also covers the buffers of Eigen's aligned allocator, e.g. the points of a
+ * pcl::PointCloud, as they go to malloc or posix_memalign directly. Other C
+ * libraries count the operator new calls only.
+ */
+std::atomic<std::size_t> allocationCount(0);
+std::atomic<std::size_t> allocatedBytes(0);
+
+void countAllocation(std::size_t size)
+{
+    allocationCount++;
+    allocatedBytes += size;
+}
+
+struct StageCounters
+{
+    std::size_t allocations;
+    /** Points processed, for the throughput; active boxes for the tracklet lookup */
+    std::size_t points;
+};
+
+const char* stageNames[] = { "load", "tracklet lookup", "crop batched", "crop per tracklet", "crop kernel", "crop fused", "voxel grid", "color map", "projection" };
+const int numberOfStages = sizeof(stageNames) / sizeof(stageNames[0]);
+
+}
+
+#if defined(__GLIBC__)
+
+extern "C"
+{
+
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t count, std::size_t size);
+void* __libc_realloc(void* memory, std::size_t size);
+void* __libc_memalign(std::size_t alignment, std::size_t size);
+
+void* malloc(std::size_t size)
+{
+    countAllocation(size);
+    return __libc_malloc(size);
+}
+
+void* calloc(std::size_t count, std::size_t size)
+{
+    countAllocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* memory, std::size_t size)
+{
+    countAllocation(size);
+    return __libc_realloc(memory, size);
+}
+
+int posix_memalign(void** memory, std::size_t alignment, std::size_t size)
+{
+    countAllocation(size);
+    *memory = __libc_memalign(alignment, size);
+    return *memory ? 0 : ENOMEM;
+}
+
+void* aligned_alloc(std::size_t alignment, std::size_t size)
+{
+    countAllocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+}
+
+#else
+
+void* operator new(std::size_t size)
+{
+    countAllocation(size);
+    void* memory = std::malloc(size ? size : 1);
+    if (!memory)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+    std::free(memory);
+}
+
+#endif
+
+int main(int argc, char* argv[])
+{
+    boost::program_options::options_description desc("Program options");
+    desc.add_options()
+        ("help", "Produce this help message.")
+        ("data-directory", boost::program_options::value<std::string>(), "Set the folder containing the KITTI raw data sets.")
+        ("rescan", "Search the data directory for data sets even if a manifest exists.")
+        ("dataset", boost::program_options::value<std::vector<int> >()->multitoken(), "Set the KITTI data sets to replay by drive number, plus 10000 for each earlier recording date if there are several (default: all available).")
+        ("frames", boost::program_options::value<int>(), "Replay at most this many frames per data set.")
+        ("lod-leaf-size", boost::program_options::value<float>(), "Set the voxel size in meters of the reduced cloud (default 0.2).")
+        ("instruction-set", boost::program_options::value<std::string>(), "Run the box kernel with scalar, sse2 or avx2 code (default: best supported).")
+        ("no-archive", "Load the .bin files even if a data set has a sequence archive.")
+        ("decode-threads", boost::program_options::value<int>(), "Set the number of threads decoding a compressed archive frame (default 1).")
+        ("json", "Print the results as JSON.")
+    ;
+
+    boost::program_options::variables_map vm;
+    try
+    {
+        boost::program_options::store(boost::program_options::parse_command_line(argc, argv, desc), vm);
+        boost::program_options::notify(vm);
+    }
+    catch (const boost::program_options::error& e)
+    {
+        std::cerr << e.what() << std::endl << desc << std::endl;
+        return 1;
+    }
+
+    if (vm.count("help")) {
+        std::cout << desc << std::endl;
+        return 1;
+    }
+
+    if (vm.count("data-directory")) {
+        KittiConfig::setDataDirectory(vm["data-directory"].as<std::string>());
+    }
+    if (!KittiConfig::initAvailableDatasets(vm.count("rescan") > 0)) {
+        return 1;
+    }
+
+    std::vector<int> datasets = KittiConfig::availableDatasets;
+    if (vm.count("dataset")) {
+        datasets = vm["dataset"].as<std::vector<int> >();
+    }
+    if (vm.count("instruction-set")) {
+        std::string name = vm["instruction-set"].as<std::string>();
+        KittiBoxKernel::InstructionSet instructionSet = KittiBoxKernel::SCALAR;
+        if (name == "sse2")
+            instructionSet = KittiBoxKernel::SSE2;
+        else if (name == "avx2")
+            instructionSet = KittiBoxKernel::AVX2;
+        else if (name != "scalar") {
+            std::cerr << "Unknown instruction set " << name << std::endl << desc << std::endl;
+            return 1;
+        }
+        if (!KittiBoxKernel::setInstructionSet(instructionSet)) {
+            std::cerr << "This CPU does not support " << name << "." << std::endl;
+            return 1;
+        }
+    }
+    const char* instructionSetName = KittiBoxKernel::getInstructionSetName(KittiBoxKernel::getInstructionSet());
+
+    KittiConfig::setSequenceArchiveEnabled(vm.count("no-archive") == 0);
+
+    float leafSize = vm.count("lod-leaf-size") ? vm["lod-leaf-size"].as<float>() : 0.2f;
+    int decodeThreads = vm.count("decode-threads") ? vm["decode-threads"].as<int>() : 1;
+    int frameLimit = vm.count("frames") ? vm["frames"].as<int>() : -1;
+    bool json = vm.count("json") > 0;
+
+    KittiStageTimes times(4096);
+    StageCounters counters[numberOfStages] = {};
+    std::size_t frames = 0;
+    std::size_t points = 0;
+    // Buffers created by the data set pools, in total and after the first frame of each data set
+    std::size_t bufferAllocations = 0;
+    std::size_t warmBufferAllocations = 0;
+    std::size_t allocationsBefore = allocationCount;
+    std::size_t bytesBefore = allocatedBytes;
+
+    std::vector<std::vector<int> > indices;
+    std::vector<int> trackletIndices;
+    KittiPointFrame trackletFrame;
+    KittiPointFrame pointFrame;
+    KittiVoxelGrid voxelGrid(leafSize);
+    KittiPointFrame reducedFrame;
+    std::size_t reducedPoints = 0;
+    KittiColorMap intensityMap(0.0f, 1.0f);
+    std::vector<unsigned char> colors;
+    KittiProjectedPoints projectedPoints;
+    KittiPointCloud::Ptr pointCloud(new KittiPointCloud);
+    for (std::size_t d = 0; d < datasets.size(); ++d)
+    {
+        KittiDataset dataset(datasets[d]);
+        dataset.setDecodeThreads(decodeThreads);
+        KittiCameraCalibration::ConstPtr calibration = dataset.getCameraCalibration();
+        int numberOfFrames = dataset.getNumberOfFrames();
+        if (frameLimit >= 0 && frameLimit < numberOfFrames)
+            numberOfFrames = frameLimit;
+        if (!json)
+            std::cout << "Replaying " << numberOfFrames << " frames of data set " << datasets[d]
+                      << (dataset.hasSequenceArchive() ? " from its sequence archive" : "") << std::endl;
+
+        for (int frameId = 0; frameId < numberOfFrames; ++frameId)
+        {
+            std::size_t allocations = allocationCount;
+            {
+                KittiScopedTimer timer(times, stageNames[0]);
+                dataset.getPointFrame(frameId, pointFrame);
+            }
+            counters[0].allocations += allocationCount - allocations;
+            counters[0].points += pointFrame.size();
+
+            // pcl::CropBox below needs the points as a PCL cloud
+            pointFrame.toPointCloud(*pointCloud);
+
+            allocations = allocationCount;
+            KittiActiveTracklets tracklets;
+            {
+                KittiScopedTimer timer(times, stageNames[1]);
+                tracklets = dataset.getActiveTracklets(frameId);
+            }
+            counters[1].allocations += allocationCount - allocations;
+            counters[1].points += tracklets.size();
+
+            allocations = allocationCount;
+            {
+                KittiScopedTimer timer(times, stageNames[2]);
+                dataset.getTrackletPointIndices(pointFrame, frameId, indices);
+            }
+            counters[2].allocations += allocationCount - allocations;
+            counters[2].points += pointCloud->size();
+
+            allocations = allocationCount;
+            {
+                KittiScopedTimer timer(times, stageNames[3]);
+                for (int i = 0; i < tracklets.size(); ++i)
+                {
+                    dataset.getTrackletPointCloud(pointCloud, tracklets.at(i), frameId);
+                }
+            }
+            counters[3].allocations += allocationCount - allocations;
+            counters[3].points += pointCloud->size() * tracklets.size();
+
+            allocations = allocationCount;
+            {
+                KittiScopedTimer timer(times, stageNames[4]);
+                for (int i = 0; i < tracklets.size(); ++i)
+                {
+                    dataset.getTrackletPointIndices(pointFrame, tracklets.at(i), frameId, trackletIndices);
+                }
+            }
+            counters[4].allocations += allocationCount - allocations;
+            counters[4].points += pointFrame.size() * tracklets.size();
+
+            // Crop and move above the cloud as the viewer's prefetcher does
+            allocations = allocationCount;
+            {
+                KittiScopedTimer timer(times, stageNames[5]);
+                for (int i = 0; i < tracklets.size(); ++i)
+                {
+                    dataset.getTrackletPointFrame(pointFrame, tracklets.at(i), frameId, KittiBoxKernel::POINT_FRAME,
+                                                  Eigen::Vector3f(0.0f, 0.0f, 6.0f), trackletFrame, &trackletIndices);
+                }
+            }
+            counters[5].allocations += allocationCount - allocations;
+            counters[5].points += pointFrame.size() * tracklets.size();
+
+            // The reduced cloud the viewer shows while the camera moves
+            allocations = allocationCount;
+            {
+                KittiScopedTimer timer(times, stageNames[6]);
+                voxelGrid.filter(pointFrame, reducedFrame);
+            }
+            counters[6].allocations += allocationCount - allocations;
+            counters[6].points += pointFrame.size();
+            reducedPoints += reducedFrame.size();
+
+            // Intensity colors as the viewer writes them into its actor
+            allocations = allocationCount;
+            {
+                KittiScopedTimer timer(times, stageNames[7]);
+                colors.resize(3 * pointFrame.size());
+                intensityMap.map(pointFrame.intensity(), pointFrame.size(), colors.data());
+            }
+            counters[7].allocations += allocationCount - allocations;
+            counters[7].points += pointFrame.size();
+
+            // The points drawn over the camera image, skipped without a calibration
+            if (calibration)
+            {
+                allocations = allocationCount;
+                {
+                    KittiScopedTimer timer(times, stageNames[8]);
+                    KittiProjectionKernel::project(pointFrame, calibration->veloToImage[2], 0.5f,
+                                                   calibration->imageWidth[2], calibration->imageHeight[2],
+                                                   projectedPoints);
+                }
+                counters[8].allocations += allocationCount - allocations;
+                counters[8].points += pointFrame.size();
+            }
+
+            frames++;
+            points += pointCloud->size();
+            if (frameId == 0)
+                warmBufferAllocations -= dataset.getBufferAllocations();
+        }
+        bufferAllocations += dataset.getBufferAllocations();
+        if (numberOfFrames > 0)
+            warmBufferAllocations += dataset.getBufferAllocations();
+    }
+
+    // Every Velodyne point is stored as four floats
+    double megabytes = points * 4.0 * sizeof(float) / (1024.0 * 1024.0);
+    std::size_t allocations = allocationCount - allocationsBefore;
+    std::size_t bytes = allocatedBytes - bytesBefore;
+
+    if (json)
+    {
+        std::cout << "{" << std::endl
+                  << "  \"datasets\": [";
+        for (std::size_t d = 0; d < datasets.size(); ++d)
+            std::cout << (d ? ", " : "") << datasets[d];
+        std::cout << "]," << std::endl
+                  << "  \"instruction_set\": \"" << instructionSetName << "\"," << std::endl
+                  << "  \"decode_threads\": " << decodeThreads << "," << std::endl
+                  << "  \"frames\": " << frames << "," << std::endl
+                  << "  \"points\": " << points << "," << std::endl
+                  << "  \"megabytes\": " << megabytes << "," << std::endl
+                  << "  \"allocations\": " << allocations << "," << std::endl
+                  << "  \"allocated_bytes\": " << bytes << "," << std::endl
+                  << "  \"buffer_allocations\": " << bufferAllocations << "," << std::endl
+                  << "  \"buffer_allocations_after_first_frame\": " << warmBufferAllocations << "," << std::endl
+                  << "  \"lod_leaf_size\": " << leafSize << "," << std::endl
+                  << "  \"reduced_points\": " << reducedPoints << "," << std::endl
+                  << "  \"stages\": {" << std::endl;
+        for (int s = 0; s < numberOfStages; ++s)
+        {
+            KittiStageTimes::Summary summary = times.getSummary(stageNames[s]);
+            double seconds = summary.total / 1000.0;
+            std::cout << "    \"" << stageNames[s] << "\": {"
+                      << "\"total_ms\": " << summary.total
+                      << ", \"p50_ms\": " << summary.p50
+                      << ", \"p95_ms\": " << summary.p95
+                      << ", \"max_ms\": " << summary.max
+                      << ", \"frames_per_second\": " << (seconds > 0.0 ? frames / seconds : 0.0);
+            if (s == 1)
+                std::cout << ", \"boxes_per_frame\": " << (frames ? (double) counters[s].points / frames : 0.0);
+            else
+                std::cout << ", \"points_per_second\": " << (seconds > 0.0 ? counters[s].points / seconds : 0.0);
+            std::cout << ", \"allocations_per_frame\": " << (frames ? (double) counters[s].allocations / frames : 0.0);
+            if (s == 0)
+                std::cout << ", \"megabytes_per_second\": " << (seconds > 0.0 ? megabytes / seconds : 0.0);
+            std::cout << "}" << (s + 1 < numberOfStages ? "," : "") << std::endl;
+        }
+        std::cout << "  }" << std::endl
+                  << "}" << std::endl;
+        return 0;
+    }
+
+    std::cout << frames << " frames, " << points << " points, " << megabytes << " MB, "
+              << instructionSetName << " box kernel" << std::endl;
+    for (int s = 0; s < numberOfStages; ++s)
+    {
+        KittiStageTimes::Summary summary = times.getSummary(stageNames[s]);
+        double seconds = summary.total / 1000.0;
+        std::cout << stageNames[s] << ": "
+                  << (seconds > 0.0 ? frames / seconds : 0.0) << " frames/s, ";
+        if (s == 1)
+            std::cout << (frames ? (double) counters[s].points / frames : 0.0) << " boxes/frame, ";
+        else
+            std::cout << (seconds > 0.0 ? counters[s].points / seconds : 0.0) << " points/s, ";
+        if (s == 0)
+            std::cout << (seconds > 0.0 ? megabytes / seconds : 0.0) << " MB/s, ";
+        std::cout << "p50/p95/max " << summary.p50 << "/" << summary.p95 << "/" << summary.max << " ms, "
+                  << (frames ? (double) counters[s].allocations / frames : 0.0) << " allocations/frame"
+                  << std::endl;
+    }
+    std::cout << allocations << " allocations, " << bytes << " bytes allocated in total" << std::endl;
+    std::cout << bufferAllocations << " pooled buffers created, "
+              << warmBufferAllocations << " after the first frame of each data set" << std::endl;
+    std::cout << reducedPoints << " points in " << leafSize << " m voxels ("
+              << (points ? 100.0 * reducedPoints / points : 0.0) << "% of all points)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,136 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include "KittiBoxActor.h"
+
+#include <vtkCellData.h>
+#include <vtkFloatArray.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkProperty.h>
+#include <vtkVersion.h>
+
+namespace
+{
+
+const int cornersPerBox = 8;
+const int edgesPerBox = 12;
+
+/** Corner i has x = +0.5 if bit 0 is set, y if bit 1, z if bit 2 */
+const int boxEdges[edgesPerBox][2] = {
+    { 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 7 },
+    { 0, 2 }, { 1, 3 }, { 4, 6 }, { 5, 7 },
+    { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 }
+};
+
+}
+
+KittiBoxActor::KittiBoxActor(vtkSmartPointer<vtkRenderer> renderer) :
+    _renderer(renderer),
+    _polyData(vtkSmartPointer<vtkPolyData>::New()),
+    _points(vtkSmartPointer<vtkPoints>::New()),
+    _lines(vtkSmartPointer<vtkCellArray>::New()),
+    _lineIds(vtkSmartPointer<vtkIdTypeArray>::New()),
+    _colors(vtkSmartPointer<vtkUnsignedCharArray>::New()),
+    _actor(vtkSmartPointer<vtkActor>::New()),
+    _numberOfBoxes(0),
+    _numberOfBoxCells(0)
+{
+    _points->SetDataTypeToFloat();
+    _colors->SetNumberOfComponents(3);
+    _colors->SetName("Colors");
+    _polyData->SetPoints(_points);
+    _polyData->SetLines(_lines);
+    _polyData->GetCellData()->SetScalars(_colors);
+
+    vtkSmartPointer<vtkPolyDataMapper> mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+#if VTK_MAJOR_VERSION < 6
+    mapper->SetInput(_polyData);
+#else
+    mapper->SetInputData(_polyData);
+#endif
+    mapper->SetScalarModeToUseCellData();
+    mapper->ScalarVisibilityOn();
+
+    _actor->SetMapper(mapper);
+    _actor->GetProperty()->SetLineWidth(2.0);
+    _actor->GetProperty()->LightingOff();
+    _actor->SetVisibility(false);
+    _renderer->AddActor(_actor);
+}
+
+KittiBoxActor::~KittiBoxActor()
+{
+    _renderer->RemoveActor(_actor);
+}
+
+void KittiBoxActor::resize(int numberOfBoxes)
+{
+    // vtkDataArray::SetNumberOfTuples keeps the allocation when shrinking
+    _numberOfBoxes = numberOfBoxes;
+    _points->SetNumberOfPoints(cornersPerBox * _numberOfBoxes);
+    _colors->SetNumberOfTuples(edgesPerBox * _numberOfBoxes);
+}
+
+void KittiBoxActor::setBox(int index, const Eigen::Affine3f& pose, unsigned char r, unsigned char g, unsigned char b)
+{
+    vtkIdType box = index;
+    float* corners = static_cast<vtkFloatArray*>(_points->GetData())->GetPointer(3 * cornersPerBox * box);
+    for (int i = 0; i < cornersPerBox; ++i, corners += 3)
+    {
+        Eigen::Vector3f corner(i & 1 ? 0.5f : -0.5f, i & 2 ? 0.5f : -0.5f, i & 4 ? 0.5f : -0.5f);
+        Eigen::Map<Eigen::Vector3f> point(corners);
+        point = pose * corner;
+    }
+
+    unsigned char* colors = _colors->GetPointer(3 * edgesPerBox * box);
+    for (int i = 0; i < edgesPerBox; ++i, colors += 3)
+    {
+        colors[0] = r;
+        colors[1] = g;
+        colors[2] = b;
+    }
+}
+
+void KittiBoxActor::update()
+{
+    // One line cell (2, a, b) per edge, rewritten only when the box count changes
+    if (_numberOfBoxCells != _numberOfBoxes)
+    {
+        _lineIds->SetNumberOfValues(3 * edgesPerBox * _numberOfBoxes);
+        vtkIdType* ids = _lineIds->GetPointer(0);
+        for (vtkIdType box = 0; box < _numberOfBoxes; ++box)
+        {
+            for (int i = 0; i < edgesPerBox; ++i, ids += 3)
+            {
+                ids[0] = 2;
+                ids[1] = cornersPerBox * box + boxEdges[i][0];
+                ids[2] = cornersPerBox * box + boxEdges[i][1];
+            }
+        }
+        _lines->SetCells(edgesPerBox * _numberOfBoxes, _lineIds);
+        _numberOfBoxCells = _numberOfBoxes;
+    }
+
+    _points->Modified();
+    _colors->Modified();
+    _polyData->Modified();
+}
+
+void KittiBoxActor::setVisible(bool visible)
+{
+    _actor->SetVisibility(visible);
+}
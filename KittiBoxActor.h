@@ -0,0 +1,77 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#ifndef KITTIBOXACTOR_H
+#define KITTIBOXACTOR_H
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <eigen3/Eigen/Geometry>
+
+#include <vtkActor.h>
+#include <vtkCellArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkRenderer.h>
+#include <vtkSmartPointer.h>
+#include <vtkUnsignedCharArray.h>
+
+/**
+ * @brief The KittiBoxActor class
+ *
+ * Draws any number of boxes as the twelve edges of each, all in one line
+ * polydata with a color per edge, so the boxes of a frame are one actor and
+ * one draw call. Like KittiCloudActor it stays in the renderer and the
+ * buffers are rewritten in place for each frame.
+ *
+ * Call resize(), setBox() for every box and then update().
+ */
+class KittiBoxActor : private boost::noncopyable
+{
+
+public:
+
+    typedef boost::shared_ptr<KittiBoxActor> Ptr;
+
+    KittiBoxActor(vtkSmartPointer<vtkRenderer> renderer);
+    ~KittiBoxActor();
+
+    /** Keeps the buffers when shrinking */
+    void resize(int numberOfBoxes);
+    /** Places the unit cube centered at the origin, transformed by pose */
+    void setBox(int index, const Eigen::Affine3f& pose, unsigned char r, unsigned char g, unsigned char b);
+    void update();
+    void setVisible(bool visible);
+
+private:
+
+    vtkSmartPointer<vtkRenderer> _renderer;
+    vtkSmartPointer<vtkPolyData> _polyData;
+    vtkSmartPointer<vtkPoints> _points;
+    vtkSmartPointer<vtkCellArray> _lines;
+    vtkSmartPointer<vtkIdTypeArray> _lineIds;
+    vtkSmartPointer<vtkUnsignedCharArray> _colors;
+    vtkSmartPointer<vtkActor> _actor;
+
+    vtkIdType _numberOfBoxes;
+    /** Number of boxes the line cells were written for */
+    vtkIdType _numberOfBoxCells;
+};
+
+#endif // KITTIBOXACTOR_H
@@ -0,0 +1,165 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "KittiBoxGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <eigen3/Eigen/Geometry>
+
+const float KittiBoxGrid::cellSize = 4.0f;
+
+KittiOrientedBox::KittiOrientedBox() :
+    center(Eigen::Vector3f::Zero()),
+    toBox(Eigen::Matrix3f::Identity()),
+    halfExtents(Eigen::Vector3f::Zero()),
+    radius(0.0f),
+    yawOnly(true)
+{
+}
+
+KittiOrientedBox::KittiOrientedBox(const Eigen::Vector3f& center, const Eigen::Vector3f& rotation, const Eigen::Vector3f& halfExtents) :
+    center(center),
+    toBox((Eigen::AngleAxisf(rotation[2], Eigen::Vector3f::UnitZ())
+           * Eigen::AngleAxisf(rotation[1], Eigen::Vector3f::UnitY())
+           * Eigen::AngleAxisf(rotation[0], Eigen::Vector3f::UnitX())).toRotationMatrix().transpose()),
+    halfExtents(halfExtents),
+    // Slightly larger than the box, so rounding never moves a point of the
+    // box out of the cells of its sphere
+    radius(halfExtents.norm() * 1.001f + 0.01f),
+    yawOnly(rotation[0] == 0.0f && rotation[1] == 0.0f)
+{
+    yawBox.centerX = center[0];
+    yawBox.centerY = center[1];
+    yawBox.centerZ = center[2];
+    yawBox.cosYaw = std::cos(rotation[2]);
+    yawBox.sinYaw = std::sin(rotation[2]);
+    yawBox.halfLength = halfExtents[0];
+    yawBox.halfWidth = halfExtents[1];
+    yawBox.halfHeight = halfExtents[2];
+}
+
+bool KittiOrientedBox::contains(float x, float y, float z) const
+{
+    // The same test as KittiBoxKernel, so both find the same points
+    if (yawOnly)
+        return yawBox.contains(x, y, z);
+
+    Eigen::Vector3f offset(x - center[0], y - center[1], z - center[2]);
+    if (offset.squaredNorm() > radius * radius)
+    {
+        return false;
+    }
+    Eigen::Vector3f local = toBox * offset;
+    return std::abs(local[0]) <= halfExtents[0]
+            && std::abs(local[1]) <= halfExtents[1]
+            && std::abs(local[2]) <= halfExtents[2];
+}
+
+KittiBoxGrid::KittiBoxGrid() :
+    _min_x(0.0f), _min_y(0.0f), _max_x(-1.0f), _max_y(-1.0f),
+    _cells_x(0), _cells_y(0)
+{
+}
+
+void KittiBoxGrid::setBoxes(const std::vector<KittiOrientedBox>& boxes)
+{
+    _boxes = boxes;
+    _cells.clear();
+    _cells_x = _cells_y = 0;
+    if (_boxes.empty())
+    {
+        _min_x = _min_y = 0.0f;
+        _max_x = _max_y = -1.0f;
+        return;
+    }
+
+    // Each box is enclosed by a sphere for the grid
+    _min_x = _min_y = std::numeric_limits<float>::max();
+    _max_x = _max_y = -std::numeric_limits<float>::max();
+    for (std::size_t i = 0; i < _boxes.size(); ++i)
+    {
+        const KittiOrientedBox& box = _boxes[i];
+        _min_x = std::min(_min_x, box.center[0] - box.radius);
+        _min_y = std::min(_min_y, box.center[1] - box.radius);
+        _max_x = std::max(_max_x, box.center[0] + box.radius);
+        _max_y = std::max(_max_y, box.center[1] + box.radius);
+    }
+
+    _cells_x = (int) ((_max_x - _min_x) / cellSize) + 1;
+    _cells_y = (int) ((_max_y - _min_y) / cellSize) + 1;
+    _cells.assign(_cells_x * _cells_y, std::vector<int>());
+    for (int i = 0; i < (int) _boxes.size(); ++i)
+    {
+        const KittiOrientedBox& box = _boxes[i];
+        int firstX = (int) ((box.center[0] - box.radius - _min_x) / cellSize);
+        int lastX  = (int) ((box.center[0] + box.radius - _min_x) / cellSize);
+        int firstY = (int) ((box.center[1] - box.radius - _min_y) / cellSize);
+        int lastY  = (int) ((box.center[1] + box.radius - _min_y) / cellSize);
+        for (int y = firstY; y <= std::min(lastY, _cells_y - 1); ++y)
+        {
+            for (int x = firstX; x <= std::min(lastX, _cells_x - 1); ++x)
+            {
+                _cells[y * _cells_x + x].push_back(i);
+            }
+        }
+    }
+}
+
+const std::vector<KittiOrientedBox>& KittiBoxGrid::getBoxes() const
+{
+    return _boxes;
+}
+
+void KittiBoxGrid::collect(const KittiPointFrame& frame, std::vector<std::vector<int> >& indices) const
+{
+    indices.resize(_boxes.size());
+    for (std::size_t i = 0; i < indices.size(); ++i)
+    {
+        indices[i].clear();
+    }
+    if (_boxes.empty())
+    {
+        return;
+    }
+
+    const float* pointsX = frame.x();
+    const float* pointsY = frame.y();
+    const float* pointsZ = frame.z();
+    for (int pointIndex = 0; pointIndex < (int) frame.size(); ++pointIndex)
+    {
+        float x = pointsX[pointIndex];
+        float y = pointsY[pointIndex];
+        if (!(x >= _min_x && x <= _max_x && y >= _min_y && y <= _max_y))
+        {
+            continue;
+        }
+        int cellX = std::min((int) ((x - _min_x) / cellSize), _cells_x - 1);
+        int cellY = std::min((int) ((y - _min_y) / cellSize), _cells_y - 1);
+        const std::vector<int>& cell = _cells[cellY * _cells_x + cellX];
+        for (std::size_t j = 0; j < cell.size(); ++j)
+        {
+            if (_boxes[cell[j]].contains(x, y, pointsZ[pointIndex]))
+            {
+                indices[cell[j]].push_back(pointIndex);
+            }
+        }
+    }
+}
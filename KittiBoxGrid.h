@@ -0,0 +1,90 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef KITTIBOXGRID_H
+#define KITTIBOXGRID_H
+
+#include <vector>
+
+#include <eigen3/Eigen/Core>
+
+#include "KittiBoxKernel.h"
+#include "KittiPointFrame.h"
+
+/**
+ * @brief A box rotated about all three axes, as tracklets are labelled
+ *
+ * Boxes that are only rotated about z are tested with their KittiYawBox, so
+ * they contain exactly the points KittiBoxKernel finds.
+ */
+struct KittiOrientedBox
+{
+    KittiOrientedBox();
+    /** rotation holds the angles about x, y and z, applied in the order z, y, x as by pcl::CropBox */
+    KittiOrientedBox(const Eigen::Vector3f& center, const Eigen::Vector3f& rotation, const Eigen::Vector3f& halfExtents);
+
+    Eigen::Vector3f center;
+    /** Rotates a point relative to the center into the box frame */
+    Eigen::Matrix3f toBox;
+    Eigen::Vector3f halfExtents;
+    /** Radius of the sphere around the box */
+    float radius;
+    bool yawOnly;
+    KittiYawBox yawBox;
+
+    bool contains(float x, float y, float z) const;
+};
+
+/**
+ * @brief The KittiBoxGrid class
+ *
+ * Finds the points inside any of several boxes in a single pass. The boxes
+ * are sorted into a coarse x-y grid by their enclosing spheres, so each
+ * point is only tested against the few boxes of its cell, and points
+ * outside all cells are rejected by a bounds check.
+ *
+ * Testing all points against every box with KittiBoxKernel is faster for a
+ * few boxes; both give the same points.
+ */
+class KittiBoxGrid
+{
+
+public:
+
+    KittiBoxGrid();
+
+    /** Replaces the boxes; indices[i] of collect() belongs to boxes[i] */
+    void setBoxes(const std::vector<KittiOrientedBox>& boxes);
+    const std::vector<KittiOrientedBox>& getBoxes() const;
+
+    /** Resizes indices to one list per box and fills them with the indices of the points inside, ascending */
+    void collect(const KittiPointFrame& frame, std::vector<std::vector<int> >& indices) const;
+
+    /** Edge length of the grid cells in meters */
+    static const float cellSize;
+
+private:
+
+    std::vector<KittiOrientedBox> _boxes;
+    /** Indices of the boxes whose sphere touches each cell */
+    std::vector<std::vector<int> > _cells;
+    float _min_x, _min_y, _max_x, _max_y;
+    int _cells_x, _cells_y;
+};
+
+#endif // KITTIBOXGRID_H
@@ -0,0 +1,274 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "KittiBoxKernel.h"
+
+#include "KittiSimd.h"
+
+namespace
+{
+
+/*
+ * The test loops below hand every block with points inside the box to a
+ * sink: a bit mask of those points, the index of the first point of the
+ * block, and the box coordinates of all points of the block.
+ */
+
+/** Appends the indices of the points inside */
+struct IndexSink
+{
+    explicit IndexSink(std::vector<int>& indices) : _indices(indices) {}
+
+    void operator()(unsigned int mask, std::size_t first, const float*, const float*, const float*)
+    {
+        while (mask)
+        {
+            _indices.push_back((int) first + kittiCountTrailingZeros(mask));
+            mask &= mask - 1;
+        }
+    }
+
+    std::vector<int>& _indices;
+};
+
+/** Copies the points inside into another frame, see KittiBoxKernel::crop() */
+struct CropSink
+{
+    CropSink(const KittiPointFrame& input, KittiBoxKernel::OutputFrame outputFrame,
+             float offsetX, float offsetY, float offsetZ,
+             KittiPointFrame& output, std::vector<int>* indices) :
+        _input(input), _output_frame(outputFrame),
+        _offset_x(offsetX), _offset_y(offsetY), _offset_z(offsetZ),
+        _output(output), _indices(indices) {}
+
+    void operator()(unsigned int mask, std::size_t first, const float* length, const float* width, const float* dz)
+    {
+        while (mask)
+        {
+            int lane = kittiCountTrailingZeros(mask);
+            std::size_t i = first + lane;
+            if (_indices)
+                _indices->push_back((int) i);
+            if (_output_frame == KittiBoxKernel::BOX_FRAME)
+                _output.push_back(length[lane] + _offset_x, width[lane] + _offset_y, dz[lane] + _offset_z,
+                                  _input.intensity()[i]);
+            else
+                _output.push_back(_input.x()[i] + _offset_x, _input.y()[i] + _offset_y, _input.z()[i] + _offset_z,
+                                  _input.intensity()[i]);
+            mask &= mask - 1;
+        }
+    }
+
+    const KittiPointFrame& _input;
+    KittiBoxKernel::OutputFrame _output_frame;
+    float _offset_x, _offset_y, _offset_z;
+    KittiPointFrame& _output;
+    std::vector<int>* _indices;
+};
+
+template <typename Sink>
+void testScalar(const float* x, const float* y, const float* z, std::size_t size,
+                const KittiYawBox& box, Sink& sink)
+{
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        float length, width, height;
+        if (box.contains(x[i], y[i], z[i], length, width, height))
+        {
+            sink(1u, i, &length, &width, &height);
+        }
+    }
+}
+
+#ifdef KITTI_SIMD_X86
+
+template <typename Sink>
+KITTI_TARGET("sse2")
+void testSse2(const float* x, const float* y, const float* z, std::size_t size,
+              const KittiYawBox& box, Sink& sink)
+{
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 centerX = _mm_set1_ps(box.centerX);
+    const __m128 centerY = _mm_set1_ps(box.centerY);
+    const __m128 centerZ = _mm_set1_ps(box.centerZ);
+    const __m128 cosYaw = _mm_set1_ps(box.cosYaw);
+    const __m128 sinYaw = _mm_set1_ps(box.sinYaw);
+    const __m128 halfLength = _mm_set1_ps(box.halfLength);
+    const __m128 halfWidth = _mm_set1_ps(box.halfWidth);
+    const __m128 halfHeight = _mm_set1_ps(box.halfHeight);
+
+    for (std::size_t i = 0; i < size; i += 4)
+    {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), centerX);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i), centerY);
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(z + i), centerZ);
+        __m128 length = _mm_add_ps(_mm_mul_ps(cosYaw, dx), _mm_mul_ps(sinYaw, dy));
+        __m128 width = _mm_sub_ps(_mm_mul_ps(cosYaw, dy), _mm_mul_ps(sinYaw, dx));
+        __m128 inside = _mm_and_ps(
+                    _mm_and_ps(_mm_cmple_ps(_mm_and_ps(length, absMask), halfLength),
+                               _mm_cmple_ps(_mm_and_ps(width, absMask), halfWidth)),
+                    _mm_cmple_ps(_mm_and_ps(dz, absMask), halfHeight));
+        unsigned int mask = (unsigned int) _mm_movemask_ps(inside) & kittiTailMask(size - i, 4);
+        if (mask)
+        {
+            float lengths[4], widths[4], heights[4];
+            _mm_storeu_ps(lengths, length);
+            _mm_storeu_ps(widths, width);
+            _mm_storeu_ps(heights, dz);
+            sink(mask, i, lengths, widths, heights);
+        }
+    }
+}
+
+template <typename Sink>
+KITTI_TARGET("avx2")
+void testAvx2(const float* x, const float* y, const float* z, std::size_t size,
+              const KittiYawBox& box, Sink& sink)
+{
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m256 centerX = _mm256_set1_ps(box.centerX);
+    const __m256 centerY = _mm256_set1_ps(box.centerY);
+    const __m256 centerZ = _mm256_set1_ps(box.centerZ);
+    const __m256 cosYaw = _mm256_set1_ps(box.cosYaw);
+    const __m256 sinYaw = _mm256_set1_ps(box.sinYaw);
+    const __m256 halfLength = _mm256_set1_ps(box.halfLength);
+    const __m256 halfWidth = _mm256_set1_ps(box.halfWidth);
+    const __m256 halfHeight = _mm256_set1_ps(box.halfHeight);
+
+    for (std::size_t i = 0; i < size; i += 8)
+    {
+        __m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x + i), centerX);
+        __m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y + i), centerY);
+        __m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z + i), centerZ);
+        // Separate multiply and add, no FMA, to round like the scalar code
+        __m256 length = _mm256_add_ps(_mm256_mul_ps(cosYaw, dx), _mm256_mul_ps(sinYaw, dy));
+        __m256 width = _mm256_sub_ps(_mm256_mul_ps(cosYaw, dy), _mm256_mul_ps(sinYaw, dx));
+        __m256 inside = _mm256_and_ps(
+                    _mm256_and_ps(_mm256_cmp_ps(_mm256_and_ps(length, absMask), halfLength, _CMP_LE_OQ),
+                                  _mm256_cmp_ps(_mm256_and_ps(width, absMask), halfWidth, _CMP_LE_OQ)),
+                    _mm256_cmp_ps(_mm256_and_ps(dz, absMask), halfHeight, _CMP_LE_OQ));
+        unsigned int mask = (unsigned int) _mm256_movemask_ps(inside) & kittiTailMask(size - i, 8);
+        if (mask)
+        {
+            float lengths[8], widths[8], heights[8];
+            _mm256_storeu_ps(lengths, length);
+            _mm256_storeu_ps(widths, width);
+            _mm256_storeu_ps(heights, dz);
+            sink(mask, i, lengths, widths, heights);
+        }
+    }
+}
+
+#endif
+
+bool cpuSupports(KittiBoxKernel::InstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+    case KittiBoxKernel::SCALAR:
+        return true;
+    case KittiBoxKernel::SSE2:
+        return kittiCpuSupportsSse2();
+    case KittiBoxKernel::AVX2:
+        return kittiCpuSupportsAvx2();
+    }
+    return false;
+}
+
+KittiBoxKernel::InstructionSet detectInstructionSet()
+{
+    if (cpuSupports(KittiBoxKernel::AVX2))
+        return KittiBoxKernel::AVX2;
+    if (cpuSupports(KittiBoxKernel::SSE2))
+        return KittiBoxKernel::SSE2;
+    return KittiBoxKernel::SCALAR;
+}
+
+KittiBoxKernel::InstructionSet selectedInstructionSet = detectInstructionSet();
+
+template <typename Sink>
+void test(const float* x, const float* y, const float* z, std::size_t size,
+          const KittiYawBox& box, Sink& sink)
+{
+#ifdef KITTI_SIMD_X86
+    switch (selectedInstructionSet)
+    {
+    case KittiBoxKernel::AVX2:
+        testAvx2(x, y, z, size, box, sink);
+        return;
+    case KittiBoxKernel::SSE2:
+        testSse2(x, y, z, size, box, sink);
+        return;
+    default:
+        break;
+    }
+#endif
+    testScalar(x, y, z, size, box, sink);
+}
+
+}
+
+void KittiBoxKernel::collect(const float* x, const float* y, const float* z, std::size_t size,
+                             const KittiYawBox& box, std::vector<int>& indices)
+{
+    IndexSink sink(indices);
+    test(x, y, z, size, box, sink);
+}
+
+void KittiBoxKernel::crop(const KittiPointFrame& input, const KittiYawBox& box,
+                          OutputFrame outputFrame, float offsetX, float offsetY, float offsetZ,
+                          KittiPointFrame& output, std::vector<int>* indices)
+{
+    output.clear();
+    if (indices)
+        indices->clear();
+    CropSink sink(input, outputFrame, offsetX, offsetY, offsetZ, output, indices);
+    test(input.x(), input.y(), input.z(), input.size(), box, sink);
+}
+
+KittiBoxKernel::InstructionSet KittiBoxKernel::getInstructionSet()
+{
+    return selectedInstructionSet;
+}
+
+bool KittiBoxKernel::setInstructionSet(InstructionSet instructionSet)
+{
+    if (!isSupported(instructionSet))
+        return false;
+    selectedInstructionSet = instructionSet;
+    return true;
+}
+
+bool KittiBoxKernel::isSupported(InstructionSet instructionSet)
+{
+    return cpuSupports(instructionSet);
+}
+
+const char* KittiBoxKernel::getInstructionSetName(InstructionSet instructionSet)
+{
+    switch (instructionSet)
+    {
+    case SCALAR:
+        return "scalar";
+    case SSE2:
+        return "SSE2";
+    case AVX2:
+        return "AVX2";
+    }
+    return "unknown";
+}
@@ -0,0 +1,129 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef KITTIBOXKERNEL_H
+#define KITTIBOXKERNEL_H
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#include "KittiPointFrame.h"
+
+/**
+ * @brief A box that is only rotated about the z axis
+ *
+ * KITTI tracklets are labelled with a yaw angle only (rx and ry are zero),
+ * so testing a point needs a 2D rotation and three range checks.
+ */
+struct KittiYawBox
+{
+    KittiYawBox() :
+        centerX(0.0f), centerY(0.0f), centerZ(0.0f), cosYaw(1.0f), sinYaw(0.0f),
+        halfLength(0.0f), halfWidth(0.0f), halfHeight(0.0f) {}
+
+    float centerX, centerY, centerZ;
+    float cosYaw, sinYaw;
+    float halfLength, halfWidth, halfHeight;
+
+    /**
+     * Tests a point and returns its offset from the center rotated by -yaw.
+     * The vector code of KittiBoxKernel computes the same operations in the
+     * same order, so all paths agree on points at the faces of the box.
+     */
+    bool contains(float x, float y, float z, float& length, float& width, float& height) const
+    {
+        float dx = x - centerX;
+        float dy = y - centerY;
+        height = z - centerZ;
+        length = cosYaw * dx + sinYaw * dy;
+        width = cosYaw * dy - sinYaw * dx;
+        return std::fabs(length) <= halfLength
+                && std::fabs(width) <= halfWidth
+                && std::fabs(height) <= halfHeight;
+    }
+
+    bool contains(float x, float y, float z) const
+    {
+        float length, width, height;
+        return contains(x, y, z, length, width, height);
+    }
+};
+
+/**
+ * @brief The KittiBoxKernel class
+ *
+ * Finds the points inside a KittiYawBox. The points are given as separate
+ * x, y and z arrays, e.g. from KittiPointFrame, and the kernel tests eight
+ * (AVX2) or four (SSE2) points per instruction. The instruction set is
+ * picked once from what the CPU supports; the scalar code is used on other
+ * architectures.
+ *
+ * A point is inside if its offset from the center, rotated by -yaw, is
+ * within the half extents, limits included, as in pcl::CropBox.
+ *
+ * crop() copies the points inside into another frame while testing them,
+ * already moved into the coordinates they are shown in, so no intermediate
+ * cloud and no second pass over the points are needed.
+ */
+class KittiBoxKernel
+{
+
+public:
+
+    enum InstructionSet
+    {
+        SCALAR,
+        SSE2,
+        AVX2
+    };
+
+    /** Coordinates of the points written by crop() */
+    enum OutputFrame
+    {
+        /** Relative to the box center and rotated by -yaw, i.e. the box is axis aligned at the origin */
+        BOX_FRAME,
+        /** Unchanged */
+        POINT_FRAME
+    };
+
+    /**
+     * Appends the indices of the points inside box to indices, in ascending
+     * order. The arrays must be readable up to size rounded up to a multiple
+     * of 8, as KittiPointFrame guarantees.
+     */
+    static void collect(const float* x, const float* y, const float* z, std::size_t size,
+                        const KittiYawBox& box, std::vector<int>& indices);
+
+    /**
+     * Replaces output by the points of input inside box, in outputFrame
+     * coordinates and then moved by offsetX, offsetY and offsetZ. If indices
+     * is not NULL, it receives their indices in input, as from collect().
+     */
+    static void crop(const KittiPointFrame& input, const KittiYawBox& box,
+                     OutputFrame outputFrame, float offsetX, float offsetY, float offsetZ,
+                     KittiPointFrame& output, std::vector<int>* indices = NULL);
+
+    static InstructionSet getInstructionSet();
+    /** Overrides the detected instruction set, e.g. for comparisons. Fails if the CPU lacks it. */
+    static bool setInstructionSet(InstructionSet instructionSet);
+    static bool isSupported(InstructionSet instructionSet);
+    static const char* getInstructionSetName(InstructionSet instructionSet);
+};
+
+#endif // KITTIBOXKERNEL_H
@@ -0,0 +1,145 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef KITTIBUFFERPOOL_H
+#define KITTIBUFFERPOOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+
+/**
+ * @brief The KittiBufferPool class
+ *
+ * Recycles the buffers a frame needs, e.g. point clouds, across frames.
+ * acquire() hands out a shared pointer whose deleter puts the buffer back
+ * into the pool instead of freeing it, so the next frame gets a buffer that
+ * already has the capacity for a typical scan. Buffers come back with their
+ * old contents; users resize them before writing.
+ *
+ * Buffers may be released from any thread and may outlive the pool, they
+ * are then deleted normally. At most maximumIdle buffers are kept.
+ *
+ * The statistics count how many buffers had to be created; in steady state
+ * playback that number stops growing.
+ */
+template <typename T>
+class KittiBufferPool : private boost::noncopyable
+{
+
+public:
+
+    typedef boost::shared_ptr<T> Ptr;
+
+    struct Statistics
+    {
+        /** Calls of acquire() */
+        std::size_t acquired;
+        /** Buffers created because none was idle */
+        std::size_t allocated;
+        /** Buffers waiting to be reused */
+        std::size_t idle;
+    };
+
+    explicit KittiBufferPool(std::size_t maximumIdle) :
+        _state(new State(maximumIdle))
+    {
+    }
+
+    Ptr acquire()
+    {
+        _state->acquired++;
+        T* buffer = NULL;
+        {
+            std::lock_guard<std::mutex> lock(_state->mutex);
+            if (!_state->idle.empty())
+            {
+                buffer = _state->idle.back();
+                _state->idle.pop_back();
+            }
+        }
+        if (!buffer)
+        {
+            _state->allocated++;
+            buffer = new T;
+        }
+        return Ptr(buffer, Releaser(_state));
+    }
+
+    Statistics getStatistics() const
+    {
+        Statistics statistics;
+        statistics.acquired = _state->acquired;
+        statistics.allocated = _state->allocated;
+        std::lock_guard<std::mutex> lock(_state->mutex);
+        statistics.idle = _state->idle.size();
+        return statistics;
+    }
+
+private:
+
+    /** Shared with the deleters, so buffers can be released after the pool is gone */
+    struct State : private boost::noncopyable
+    {
+        explicit State(std::size_t maximumIdle) :
+            maximumIdle(maximumIdle), acquired(0), allocated(0) {}
+
+        ~State()
+        {
+            for (std::size_t i = 0; i < idle.size(); ++i)
+                delete idle[i];
+        }
+
+        std::mutex mutex;
+        std::vector<T*> idle;
+        std::size_t maximumIdle;
+        std::atomic<std::size_t> acquired;
+        std::atomic<std::size_t> allocated;
+    };
+
+    struct Releaser
+    {
+        explicit Releaser(const boost::shared_ptr<State>& state) : state(state) {}
+
+        void operator()(T* buffer) const
+        {
+            boost::shared_ptr<State> pool = state.lock();
+            if (pool)
+            {
+                std::lock_guard<std::mutex> lock(pool->mutex);
+                if (pool->idle.size() < pool->maximumIdle)
+                {
+                    pool->idle.push_back(buffer);
+                    return;
+                }
+            }
+            delete buffer;
+        }
+
+        boost::weak_ptr<State> state;
+    };
+
+    boost::shared_ptr<State> _state;
+};
+
+#endif // KITTIBUFFERPOOL_H
@@ -0,0 +1,148 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include "KittiCalibration.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+
+#include <boost/format.hpp>
+
+const int KittiCameraCalibration::numberOfCameras;
+
+bool KittiCalibration::read(const boost::filesystem::path& path, Values& values)
+{
+    std::ifstream file(path.string().c_str());
+    if (!file.good())
+        return false;
+
+    values.clear();
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::size_t colon = line.find(':');
+        if (colon == std::string::npos || colon == 0)
+            continue;
+
+        std::vector<double> numbers;
+        const char* begin = line.c_str() + colon + 1;
+        char* end = NULL;
+        for (double number = std::strtod(begin, &end); end != begin; number = std::strtod(begin, &end))
+        {
+            numbers.push_back(number);
+            begin = end;
+        }
+        // Trailing text means the values are not numbers
+        while (*begin == ' ' || *begin == '\t' || *begin == '\r')
+            ++begin;
+        if (*begin == '\0' && !numbers.empty())
+            values[line.substr(0, colon)].swap(numbers);
+    }
+    return true;
+}
+
+bool KittiCalibration::getRigidTransform(const Values& values, const std::string& rotationKey,
+                                         const std::string& translationKey, Eigen::Affine3d& transform)
+{
+    Values::const_iterator rotation = values.find(rotationKey);
+    Values::const_iterator translation = values.find(translationKey);
+    if (rotation == values.end() || rotation->second.size() != 9
+            || translation == values.end() || translation->second.size() != 3)
+    {
+        return false;
+    }
+
+    transform.setIdentity();
+    for (int row = 0; row < 3; ++row)
+    {
+        for (int column = 0; column < 3; ++column)
+        {
+            transform.matrix()(row, column) = rotation->second[3 * row + column];
+        }
+        transform.matrix()(row, 3) = translation->second[row];
+    }
+    return true;
+}
+
+KittiCameraCalibration::ConstPtr KittiCalibration::getCameraCalibration(const boost::filesystem::path& veloToCamPath,
+                                                                       const boost::filesystem::path& camToCamPath)
+{
+    // Failures are remembered too, so they are reported once
+    static std::mutex mutex;
+    static std::map<std::string, KittiCameraCalibration::ConstPtr> calibrations;
+
+    std::string key = veloToCamPath.string() + '\n' + camToCamPath.string();
+    std::lock_guard<std::mutex> lock(mutex);
+    std::map<std::string, KittiCameraCalibration::ConstPtr>::iterator it = calibrations.find(key);
+    if (it != calibrations.end())
+        return it->second;
+
+    boost::shared_ptr<KittiCameraCalibration> calibration(new KittiCameraCalibration);
+    if (!readCameraCalibration(veloToCamPath, camToCamPath, *calibration))
+    {
+        std::cerr << "Warning in KittiCalibration: Could not read the camera calibration "
+                  << veloToCamPath.string() << " and " << camToCamPath.string() << std::endl;
+        calibration.reset();
+    }
+    calibrations[key] = calibration;
+    return calibration;
+}
+
+bool KittiCalibration::readCameraCalibration(const boost::filesystem::path& veloToCamPath,
+                                             const boost::filesystem::path& camToCamPath,
+                                             KittiCameraCalibration& calibration)
+{
+    Values veloToCam;
+    Values camToCam;
+    Eigen::Affine3d veloToCamera;
+    if (!read(veloToCamPath, veloToCam) || !read(camToCamPath, camToCam)
+            || !getRigidTransform(veloToCam, "R", "T", veloToCamera))
+    {
+        return false;
+    }
+
+    // Rectification of the reference camera 0, the projections include the offsets of the other cameras
+    Values::const_iterator rectification = camToCam.find("R_rect_00");
+    if (rectification == camToCam.end() || rectification->second.size() != 9)
+        return false;
+    Eigen::Matrix4d rectify = Eigen::Matrix4d::Identity();
+    for (int i = 0; i < 9; ++i)
+        rectify(i / 3, i % 3) = rectification->second[i];
+
+    for (int camera = 0; camera < KittiCameraCalibration::numberOfCameras; ++camera)
+    {
+        Values::const_iterator projection = camToCam.find((boost::format("P_rect_%|02|") % camera).str());
+        Values::const_iterator size = camToCam.find((boost::format("S_rect_%|02|") % camera).str());
+        if (projection == camToCam.end() || projection->second.size() != 12
+                || size == camToCam.end() || size->second.size() != 2)
+        {
+            return false;
+        }
+
+        Eigen::Matrix<double, 3, 4> project;
+        for (int i = 0; i < 12; ++i)
+            project(i / 4, i % 4) = projection->second[i];
+        Eigen::Matrix<double, 3, 4> veloToImage = project * rectify * veloToCamera.matrix();
+        for (int i = 0; i < 12; ++i)
+            calibration.veloToImage[camera][i] = (float) veloToImage(i / 4, i % 4);
+        calibration.imageWidth[camera] = (int) size->second[0];
+        calibration.imageHeight[camera] = (int) size->second[1];
+    }
+    return true;
+}
@@ -0,0 +1,87 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#ifndef KITTICALIBRATION_H
+#define KITTICALIBRATION_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <eigen3/Eigen/Geometry>
+
+/**
+ * @brief Projection of Velodyne points into the rectified camera images
+ */
+struct KittiCameraCalibration
+{
+    typedef boost::shared_ptr<const KittiCameraCalibration> ConstPtr;
+
+    static const int numberOfCameras = 4;
+
+    /**
+     * Row major 3x4 matrix P_rect_0i * R_rect_00 * Tr_velo_to_cam per camera,
+     * mapping homogeneous Velodyne coordinates to homogeneous pixel coordinates
+     */
+    float veloToImage[numberOfCameras][12];
+    /** Size of the rectified images, S_rect_0i */
+    int imageWidth[numberOfCameras];
+    int imageHeight[numberOfCameras];
+};
+
+/**
+ * @brief The KittiCalibration class
+ *
+ * Reads the calibration files of a recording date, e.g.
+ * calib_imu_to_velo.txt. Every line holds a key, a colon and the values:
+ *
+ *   calib_time: 25-May-2012 16:47:16
+ *   R: 9.999976e-01 7.553071e-04 -2.035826e-03 ...
+ *   T: -8.086759e-01 3.195559e-01 -7.997231e-01
+ *
+ * Lines whose values are not all numbers, like calib_time, are skipped.
+ *
+ * The camera calibration is shared by all drives of a recording date, it is
+ * parsed once per date folder and kept for the lifetime of the process.
+ */
+class KittiCalibration
+{
+
+public:
+
+    typedef std::map<std::string, std::vector<double> > Values;
+
+    static bool read(const boost::filesystem::path& path, Values& values);
+    /**
+     * Builds the transform x' = R x + T from the 3x3 row major matrix under
+     * rotationKey and the vector under translationKey
+     */
+    static bool getRigidTransform(const Values& values, const std::string& rotationKey,
+                                  const std::string& translationKey, Eigen::Affine3d& transform);
+
+    /** Reads calib_velo_to_cam.txt and calib_cam_to_cam.txt, or returns the result of an earlier call */
+    static KittiCameraCalibration::ConstPtr getCameraCalibration(const boost::filesystem::path& veloToCamPath,
+                                                                 const boost::filesystem::path& camToCamPath);
+    static bool readCameraCalibration(const boost::filesystem::path& veloToCamPath,
+                                      const boost::filesystem::path& camToCamPath,
+                                      KittiCameraCalibration& calibration);
+};
+
+#endif // KITTICALIBRATION_H
@@ -0,0 +1,288 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "KittiCloudActor.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <vtkFloatArray.h>
+#include <vtkPointData.h>
+#include <vtkPolyDataMapper.h>
+#include <vtkVersion.h>
+
+KittiCloudActor::KittiCloudActor(vtkSmartPointer<vtkRenderer> renderer) :
+    _renderer(renderer),
+    _polyData(vtkSmartPointer<vtkPolyData>::New()),
+    _points(vtkSmartPointer<vtkPoints>::New()),
+    _vertices(vtkSmartPointer<vtkCellArray>::New()),
+    _vertexIds(vtkSmartPointer<vtkIdTypeArray>::New()),
+    _colors(vtkSmartPointer<vtkUnsignedCharArray>::New()),
+    _actor(vtkSmartPointer<vtkActor>::New()),
+    _transform(vtkSmartPointer<vtkMatrix4x4>::New()),
+    _color_mode(UNIFORM),
+    _intensity_map(0.0f, 1.0f),
+    _height_map(-2.5f, 1.5f),
+    _range_map(0.0f, 60.0f),
+    _label_colors(3, 96)
+{
+    _color[0] = _color[1] = _color[2] = 255;
+
+    _points->SetDataTypeToFloat();
+    _colors->SetNumberOfComponents(3);
+    _colors->SetName("Colors");
+    _polyData->SetPoints(_points);
+    _polyData->SetVerts(_vertices);
+    _polyData->GetPointData()->SetScalars(_colors);
+
+    vtkSmartPointer<vtkPolyDataMapper> mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+#if VTK_MAJOR_VERSION < 6
+    mapper->SetInput(_polyData);
+#else
+    mapper->SetInputData(_polyData);
+#endif
+    mapper->SetScalarModeToUsePointData();
+    mapper->ScalarVisibilityOn();
+
+    _actor->SetMapper(mapper);
+    _actor->SetUserMatrix(_transform);
+    _actor->SetVisibility(false);
+    _renderer->AddActor(_actor);
+}
+
+KittiCloudActor::~KittiCloudActor()
+{
+    _renderer->RemoveActor(_actor);
+}
+
+void KittiCloudActor::setPointCloud(const KittiPointCloud& pointCloud)
+{
+    vtkIdType numberOfPoints = (vtkIdType) pointCloud.size();
+    float* data = resizePoints(numberOfPoints);
+    for (vtkIdType i = 0; i < numberOfPoints; ++i, data += 3)
+    {
+        const KittiPoint& point = pointCloud.points[i];
+        data[0] = point.x;
+        data[1] = point.y;
+        data[2] = point.z;
+    }
+    _intensities.resize(numberOfPoints);
+    for (vtkIdType i = 0; i < numberOfPoints; ++i)
+    {
+        _intensities[i] = pointCloud.points[i].intensity;
+    }
+    updatePoints(numberOfPoints);
+}
+
+void KittiCloudActor::setPointFrame(const KittiPointFrame& pointFrame)
+{
+    updatePoints(copyPointFrame(pointFrame));
+}
+
+void KittiCloudActor::setPointFrame(const KittiPointFrame& pointFrame, const std::vector<std::vector<int> >& pointIndices)
+{
+    updatePoints(copyPointFrame(pointFrame), &pointIndices);
+}
+
+vtkIdType KittiCloudActor::copyPointFrame(const KittiPointFrame& pointFrame)
+{
+    vtkIdType numberOfPoints = (vtkIdType) pointFrame.size();
+    float* data = resizePoints(numberOfPoints);
+    const float* x = pointFrame.x();
+    const float* y = pointFrame.y();
+    const float* z = pointFrame.z();
+    for (vtkIdType i = 0; i < numberOfPoints; ++i, data += 3)
+    {
+        data[0] = x[i];
+        data[1] = y[i];
+        data[2] = z[i];
+    }
+    _intensities.assign(pointFrame.intensity(), pointFrame.intensity() + numberOfPoints);
+    return numberOfPoints;
+}
+
+float* KittiCloudActor::resizePoints(vtkIdType numberOfPoints)
+{
+    // vtkDataArray::SetNumberOfTuples keeps the allocation when shrinking
+    _points->SetNumberOfPoints(numberOfPoints);
+    return static_cast<vtkFloatArray*>(_points->GetData())->GetPointer(0);
+}
+
+void KittiCloudActor::updatePoints(vtkIdType numberOfPoints, const std::vector<std::vector<int> >* pointIndices)
+{
+    _points->Modified();
+
+    // One vertex cell (1, i) per point, rewritten only when the point count changes
+    if (_vertices->GetNumberOfCells() != numberOfPoints)
+    {
+        _vertexIds->SetNumberOfValues(2 * numberOfPoints);
+        vtkIdType* ids = _vertexIds->GetPointer(0);
+        for (vtkIdType i = 0; i < numberOfPoints; ++i)
+        {
+            ids[2 * i] = 1;
+            ids[2 * i + 1] = i;
+        }
+        _vertices->SetCells(numberOfPoints, _vertexIds);
+    }
+
+    _labels.assign(numberOfPoints, 0);
+    if (pointIndices)
+        assignLabels(*pointIndices);
+    fillColors();
+    _polyData->Modified();
+}
+
+void KittiCloudActor::setColor(unsigned char r, unsigned char g, unsigned char b)
+{
+    if (_color[0] == r && _color[1] == g && _color[2] == b)
+        return;
+
+    _color[0] = r;
+    _color[1] = g;
+    _color[2] = b;
+    if (_color_mode != UNIFORM)
+        return;
+    fillColors();
+    _polyData->Modified();
+}
+
+void KittiCloudActor::setColorMode(ColorMode colorMode)
+{
+    if (_color_mode == colorMode)
+        return;
+
+    _color_mode = colorMode;
+    fillColors();
+    _polyData->Modified();
+}
+
+void KittiCloudActor::setPointLabels(const std::vector<std::vector<int> >& pointIndices)
+{
+    std::fill(_labels.begin(), _labels.end(), 0);
+    assignLabels(pointIndices);
+    if (_color_mode != LABEL)
+        return;
+    fillColors();
+    _polyData->Modified();
+}
+
+void KittiCloudActor::assignLabels(const std::vector<std::vector<int> >& pointIndices)
+{
+    for (std::size_t label = 0; label < pointIndices.size(); ++label)
+    {
+        const std::vector<int>& indices = pointIndices[label];
+        for (std::size_t i = 0; i < indices.size(); ++i)
+        {
+            if ((std::size_t) indices[i] < _labels.size())
+                _labels[indices[i]] = (unsigned short) std::min<std::size_t>(label + 1, 0xffff);
+        }
+    }
+}
+
+void KittiCloudActor::setLabelColor(int label, unsigned char r, unsigned char g, unsigned char b)
+{
+    std::size_t entry = 3 * (label + 1);
+    if (_label_colors.size() < entry + 3)
+    {
+        // Labels without a color are shown like points without a label
+        std::size_t numberOfEntries = _label_colors.size() / 3;
+        _label_colors.resize(entry + 3);
+        for (std::size_t i = numberOfEntries; i < (std::size_t) label + 1; ++i)
+        {
+            std::copy(_label_colors.begin(), _label_colors.begin() + 3, _label_colors.begin() + 3 * i);
+        }
+    }
+    _label_colors[entry] = r;
+    _label_colors[entry + 1] = g;
+    _label_colors[entry + 2] = b;
+}
+
+void KittiCloudActor::setVisible(bool visible)
+{
+    _actor->SetVisibility(visible);
+}
+
+void KittiCloudActor::setTransform(const Eigen::Affine3f& transform)
+{
+    for (int row = 0; row < 4; ++row)
+    {
+        for (int column = 0; column < 4; ++column)
+        {
+            _transform->SetElement(row, column, transform.matrix()(row, column));
+        }
+    }
+    _actor->Modified();
+}
+
+void KittiCloudActor::fillColors()
+{
+    vtkIdType numberOfPoints = _points->GetNumberOfPoints();
+    _colors->SetNumberOfTuples(numberOfPoints);
+    unsigned char* colors = _colors->GetPointer(0);
+    if (numberOfPoints == 0)
+    {
+        _colors->Modified();
+        return;
+    }
+
+    const float* data = static_cast<vtkFloatArray*>(_points->GetData())->GetPointer(0);
+    switch (_color_mode)
+    {
+    case INTENSITY:
+        _intensity_map.map(&_intensities[0], numberOfPoints, colors);
+        break;
+    case HEIGHT:
+        _values.resize(numberOfPoints);
+        for (vtkIdType i = 0; i < numberOfPoints; ++i)
+        {
+            _values[i] = data[3 * i + 2];
+        }
+        _height_map.map(&_values[0], numberOfPoints, colors);
+        break;
+    case RANGE:
+        _values.resize(numberOfPoints);
+        for (vtkIdType i = 0; i < numberOfPoints; ++i)
+        {
+            _values[i] = std::sqrt(data[3 * i] * data[3 * i] + data[3 * i + 1] * data[3 * i + 1]);
+        }
+        _range_map.map(&_values[0], numberOfPoints, colors);
+        break;
+    case LABEL:
+        for (vtkIdType i = 0; i < numberOfPoints; ++i, colors += 3)
+        {
+            // Labels without a color are gray, like points without a label
+            std::size_t entry = 3 * (std::size_t) _labels[i];
+            if (entry >= _label_colors.size())
+                entry = 0;
+            colors[0] = _label_colors[entry];
+            colors[1] = _label_colors[entry + 1];
+            colors[2] = _label_colors[entry + 2];
+        }
+        break;
+    case UNIFORM:
+    default:
+        for (vtkIdType i = 0; i < numberOfPoints; ++i, colors += 3)
+        {
+            colors[0] = _color[0];
+            colors[1] = _color[1];
+            colors[2] = _color[2];
+        }
+        break;
+    }
+    _colors->Modified();
+}
@@ -0,0 +1,132 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef KITTICLOUDACTOR_H
+#define KITTICLOUDACTOR_H
+
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <eigen3/Eigen/Geometry>
+
+#include <vtkActor.h>
+#include <vtkCellArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkMatrix4x4.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
+#include <vtkRenderer.h>
+#include <vtkSmartPointer.h>
+#include <vtkUnsignedCharArray.h>
+
+#include "KittiColorMap.h"
+#include "KittiDataset.h"
+
+/**
+ * @brief The KittiCloudActor class
+ *
+ * A point cloud actor that stays in the renderer for the lifetime of the
+ * viewer. New frames are written into the existing VTK point, cell and color
+ * buffers, which only grow when a frame has more points than any before it,
+ * instead of creating a new actor, mapper and polydata per frame as
+ * PCLVisualizer::addPointCloud does.
+ *
+ * The point colors are computed by the actor itself, either one color for
+ * all points or one of the color modes below, and written into its color
+ * buffer. The intensities of the last frame are kept, so changing the mode
+ * only recolors the points.
+ */
+class KittiCloudActor : private boost::noncopyable
+{
+
+public:
+
+    typedef boost::shared_ptr<KittiCloudActor> Ptr;
+
+    enum ColorMode
+    {
+        /** The color given to setColor() */
+        UNIFORM,
+        /** Reflectance, 0 to 1 */
+        INTENSITY,
+        /** z in Velodyne coordinates, the ground is about 1.7 m below the sensor */
+        HEIGHT,
+        /** Distance from the sensor in the xy plane */
+        RANGE,
+        /** The color of the label of each point, see setPointLabels(); gray for points without one */
+        LABEL
+    };
+
+    KittiCloudActor(vtkSmartPointer<vtkRenderer> renderer);
+    ~KittiCloudActor();
+
+    void setPointCloud(const KittiPointCloud& pointCloud);
+    void setPointFrame(const KittiPointFrame& pointFrame);
+    /** Like setPointFrame() and setPointLabels(), but colors the points only once */
+    void setPointFrame(const KittiPointFrame& pointFrame, const std::vector<std::vector<int> >& pointIndices);
+    void setColor(unsigned char r, unsigned char g, unsigned char b);
+    void setColorMode(ColorMode colorMode);
+    ColorMode getColorMode() const { return _color_mode; }
+    /**
+     * Gives the points pointIndices[i] of the current frame label i. Labels
+     * are reset by the next frame.
+     */
+    void setPointLabels(const std::vector<std::vector<int> >& pointIndices);
+    /** Used from the next setPointLabels() on */
+    void setLabelColor(int label, unsigned char r, unsigned char g, unsigned char b);
+    void setVisible(bool visible);
+    /** Moves the points when drawing them, without touching the point buffer */
+    void setTransform(const Eigen::Affine3f& transform);
+
+private:
+
+    vtkSmartPointer<vtkRenderer> _renderer;
+    vtkSmartPointer<vtkPolyData> _polyData;
+    vtkSmartPointer<vtkPoints> _points;
+    vtkSmartPointer<vtkCellArray> _vertices;
+    vtkSmartPointer<vtkIdTypeArray> _vertexIds;
+    vtkSmartPointer<vtkUnsignedCharArray> _colors;
+    vtkSmartPointer<vtkActor> _actor;
+    vtkSmartPointer<vtkMatrix4x4> _transform;
+
+    unsigned char _color[3];
+    ColorMode _color_mode;
+    KittiColorMap _intensity_map;
+    KittiColorMap _height_map;
+    KittiColorMap _range_map;
+    std::vector<float> _intensities;
+    /** Scratch values for the color maps */
+    std::vector<float> _values;
+    /** 0 for points without a label, else label + 1 */
+    std::vector<unsigned short> _labels;
+    /** r, g, b per entry of _labels */
+    std::vector<unsigned char> _label_colors;
+    /** Sizes the point buffer and returns it for writing x, y, z triples */
+    float* resizePoints(vtkIdType numberOfPoints);
+    /** Copies the coordinates and intensities of a frame, returns the number of points */
+    vtkIdType copyPointFrame(const KittiPointFrame& pointFrame);
+    /** Updates vertex cells, labels and colors after new points were written */
+    void updatePoints(vtkIdType numberOfPoints, const std::vector<std::vector<int> >* pointIndices = NULL);
+    /** Sets the labels of setPointLabels() without coloring the points */
+    void assignLabels(const std::vector<std::vector<int> >& pointIndices);
+    void fillColors();
+};
+
+#endif // KITTICLOUDACTOR_H
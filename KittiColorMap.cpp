@@ -0,0 +1,79 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include "KittiColorMap.h"
+
+namespace
+{
+
+/** Control points of the table, evenly spaced from minimum to maximum */
+const float rainbow[][3] = {
+    { 0.0f, 0.0f, 1.0f },
+    { 0.0f, 1.0f, 1.0f },
+    { 0.0f, 1.0f, 0.0f },
+    { 1.0f, 1.0f, 0.0f },
+    { 1.0f, 0.0f, 0.0f }
+};
+const int numberOfControlPoints = sizeof(rainbow) / sizeof(rainbow[0]);
+
+}
+
+const int KittiColorMap::size;
+
+KittiColorMap::KittiColorMap(float minimum, float maximum)
+{
+    setRange(minimum, maximum);
+
+    for (int i = 0; i < size; ++i)
+    {
+        float position = (float) i / (size - 1) * (numberOfControlPoints - 1);
+        int segment = (int) position;
+        if (segment >= numberOfControlPoints - 1)
+            segment = numberOfControlPoints - 2;
+        float weight = position - segment;
+        for (int c = 0; c < 3; ++c)
+        {
+            float value = (1.0f - weight) * rainbow[segment][c] + weight * rainbow[segment + 1][c];
+            _table[3 * i + c] = (unsigned char) (value * 255.0f + 0.5f);
+        }
+    }
+}
+
+void KittiColorMap::setRange(float minimum, float maximum)
+{
+    _minimum = minimum;
+    _maximum = maximum > minimum ? maximum : minimum + 1.0f;
+}
+
+void KittiColorMap::map(const float* values, std::size_t numberOfValues, unsigned char* rgb) const
+{
+    float scale = (size - 1) / (_maximum - _minimum);
+    float offset = 0.5f - _minimum * scale;
+    for (std::size_t i = 0; i < numberOfValues; ++i, rgb += 3)
+    {
+        // Written so NaN ends up at the first entry
+        float position = values[i] * scale + offset;
+        if (!(position > 0.0f))
+            position = 0.0f;
+        if (position > size - 1)
+            position = size - 1;
+        const unsigned char* color = _table + 3 * (int) position;
+        rgb[0] = color[0];
+        rgb[1] = color[1];
+        rgb[2] = color[2];
+    }
+}
@@ -0,0 +1,56 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#ifndef KITTICOLORMAP_H
+#define KITTICOLORMAP_H
+
+#include <cstddef>
+
+/**
+ * @brief The KittiColorMap class
+ *
+ * Maps scalar values, e.g. the intensity or height of points, to colors
+ * through a table of 256 colors running from blue over green to red. Values
+ * outside [minimum, maximum] get the color of the nearest end. The colors
+ * are written as r, g, b bytes into a buffer of the caller, so a viewer can
+ * map straight into the color array of its actor.
+ */
+class KittiColorMap
+{
+
+public:
+
+    static const int size = 256;
+
+    KittiColorMap(float minimum, float maximum);
+
+    float getMinimum() const { return _minimum; }
+    float getMaximum() const { return _maximum; }
+    void setRange(float minimum, float maximum);
+
+    /** Writes 3 * numberOfValues bytes to rgb */
+    void map(const float* values, std::size_t numberOfValues, unsigned char* rgb) const;
+    const unsigned char* getColor(int index) const { return _table + 3 * index; }
+
+private:
+
+    float _minimum;
+    float _maximum;
+    unsigned char _table[3 * size];
+};
+
+#endif // KITTICOLORMAP_H
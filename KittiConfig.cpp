@@ -18,69 +18,414 @@ limitations under the License.
 
 #include "KittiConfig.h"
 
+#include <cctype>
+#include <cstdlib>
 #include <string>
 #include <vector>
 #include <iostream>
 
+#include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/format.hpp>
 
+#include "KittiHash.h"
+
 //std::string KittiConfig::data_directory = "../KittiData";
-std::string KittiConfig::data_directory = "D:\\KITTI\\2011_09_26";
+std::string KittiConfig::data_directory = std::getenv("KITTI_DATA_DIRECTORY") ? std::getenv("KITTI_DATA_DIRECTORY") : "D:\\KITTI\\2011_09_26";
 std::string KittiConfig::raw_data_directory = "";
 std::string KittiConfig::dataset_folder_template = "%|04|_sync";
-std::string KittiConfig::point_cloud_directory = "velodyne_points\\data";
+std::string KittiConfig::point_cloud_directory = "velodyne_points/data";
 std::string KittiConfig::point_cloud_file_template = "%|010|.bin";
-std::string KittiConfig::image_directory = "image_02\\data";
-std::string KittiConfig::image_file_template = "%|010|.png";
+std::string KittiConfig::sequence_archive_file_name = "velodyne_points.kseq";
+bool KittiConfig::sequence_archive_enabled = true;
+const int KittiConfig::numberOfCameras;
+std::string KittiConfig::image_directories[KittiConfig::numberOfCameras] = {
+    "image_00/data", "image_01/data", "image_02/data", "image_03/data"
+};
+std::string KittiConfig::image_file_templates[KittiConfig::numberOfCameras] = {
+    "%|010|.png", "%|010|.png", "%|010|.png", "%|010|.png"
+};
+std::string KittiConfig::oxts_directory = "oxts/data";
+std::string KittiConfig::oxts_file_template = "%|010|.txt";
+std::string KittiConfig::imu_to_velo_calibration_file_name = "calib_imu_to_velo.txt";
+std::string KittiConfig::velo_to_cam_calibration_file_name = "calib_velo_to_cam.txt";
+std::string KittiConfig::cam_to_cam_calibration_file_name = "calib_cam_to_cam.txt";
 std::string KittiConfig::tracklets_directory = ".";
 std::string KittiConfig::tracklets_file_name = "tracklet_labels.xml";
+std::string KittiConfig::tracklets_cache_file_name = "tracklet_labels.cache";
+std::string KittiConfig::manifest_file_name = "kitti_manifest.txt";
+std::string KittiConfig::frame_index_file_name = "velodyne_frame_index.cache";
 
-const std::vector<int> KittiConfig::availableDatasets = KittiConfig::initAvailableDatasets();
+std::vector<int> KittiConfig::availableDatasets;
+std::vector<KittiDatasetInfo> KittiConfig::datasetInfos;
 
-boost::filesystem::path KittiConfig::getPointCloudPath(int dataset)
+KittiPathTemplate::KittiPathTemplate() :
+    _compiled(false),
+    _width(0),
+    _fill(' ')
+{
+}
+
+KittiPathTemplate::KittiPathTemplate(const boost::filesystem::path& directory, const std::string& fileTemplate) :
+    _file_template(fileTemplate),
+    _directory(directory),
+    _compiled(false),
+    _width(0),
+    _fill(' ')
+{
+    compile();
+}
+
+void KittiPathTemplate::compile()
+{
+    std::size_t begin = _file_template.find('%');
+    if (begin == std::string::npos)
+        return;
+
+    // Parse the directive: %|0N| and %0Nd as used by the predefined
+    // templates, and the plain %d and %1%
+    std::size_t position = begin + 1;
+    bool piped = position < _file_template.size() && _file_template[position] == '|';
+    if (piped)
+        ++position;
+    char fill = ' ';
+    if (position < _file_template.size() && _file_template[position] == '0')
+    {
+        fill = '0';
+        ++position;
+    }
+    std::size_t width = 0;
+    std::size_t digitsBegin = position;
+    while (position < _file_template.size() && std::isdigit((unsigned char) _file_template[position]))
+    {
+        width = 10 * width + (_file_template[position] - '0');
+        ++position;
+    }
+    if (position >= _file_template.size())
+        return;
+    char terminator = _file_template[position];
+    if (piped ? terminator != '|'
+              : !(terminator == 'd' || (terminator == '%' && fill == ' ' && position > digitsBegin)))
+    {
+        return;
+    }
+    if (!piped && terminator == '%')
+        width = 0;
+
+    std::string suffix = _file_template.substr(position + 1);
+    if (suffix.find('%') != std::string::npos || width > 32)
+        return;
+
+    _prefix = _directory.string();
+    if (!_prefix.empty())
+        _prefix += boost::filesystem::path::preferred_separator;
+    _prefix += _file_template.substr(0, begin);
+    _suffix = suffix;
+    _width = width;
+    _fill = fill;
+    _compiled = true;
+}
+
+void KittiPathTemplate::format(int frameId, std::string& path) const
+{
+    if (!_compiled || frameId < 0)
+    {
+        path = (_directory / (boost::format(_file_template) % frameId).str()).string();
+        return;
+    }
+
+    char digits[16];
+    std::size_t length = 0;
+    unsigned int value = frameId;
+    do
+    {
+        digits[length++] = (char) ('0' + value % 10);
+        value /= 10;
+    } while (value);
+
+    // assign() and append() reuse the capacity of the caller's buffer
+    path.assign(_prefix);
+    if (length < _width)
+        path.append(_width - length, _fill);
+    while (length)
+        path += digits[--length];
+    path += _suffix;
+}
+
+std::string KittiPathTemplate::get(int frameId) const
+{
+    std::string path;
+    format(frameId, path);
+    return path;
+}
+
+void KittiConfig::setDataDirectory(const std::string& directory)
+{
+    data_directory = directory;
+    availableDatasets.clear();
+    datasetInfos.clear();
+}
+
+const std::string& KittiConfig::getDataDirectory()
+{
+    return data_directory;
+}
+
+bool KittiConfig::initAvailableDatasets(bool rescan)
 {
+    boost::filesystem::path rootPath = boost::filesystem::path(data_directory) / raw_data_directory;
+    boost::filesystem::path manifestPath = rootPath / manifest_file_name;
+
+    datasetInfos.clear();
+    if (rescan || !KittiDatasetManifest::load(manifestPath, rootPath, datasetInfos))
+    {
+        std::cout << "Scanning " << rootPath.string() << " for data sets..." << std::endl;
+        std::vector<KittiDatasetManifest::Folder> folders;
+        datasetInfos = KittiDatasetManifest::scan(rootPath, &folders);
+        if (!datasetInfos.empty() && !KittiDatasetManifest::save(manifestPath, rootPath, datasetInfos, folders))
+        {
+            std::cerr << "Warning in KittiConfig: Could not write the data set manifest "
+                      << manifestPath.string() << std::endl;
+        }
+    }
+
+    // Only drives with point clouds can be shown. Drive numbers repeat across
+    // recording dates, so the drives of each later date get ids in the next
+    // block of KittiDatasetInfo::dateIdStride; the manifest is sorted by date.
+    availableDatasets.clear();
+    std::vector<KittiDatasetInfo> usable;
+    int dateIndex = -1;
+    for (std::size_t i = 0; i < datasetInfos.size(); ++i)
+    {
+        KittiDatasetInfo info = datasetInfos[i];
+        if (!info.hasStream(KittiDatasetInfo::VELODYNE) || info.numberOfFrames == 0
+                || info.number >= KittiDatasetInfo::dateIdStride)
+            continue;
+        if (usable.empty() || usable.back().date != info.date)
+            dateIndex++;
+        else if (usable.back().number == info.number)
+        {
+            std::cerr << "Warning in KittiConfig: Ignoring drive " << info.number << " of " << info.date
+                      << " at " << info.directory.string() << ", it was already found at "
+                      << usable.back().directory.string() << std::endl;
+            continue;
+        }
+        info.id = dateIndex * KittiDatasetInfo::dateIdStride + info.number;
+        usable.push_back(info);
+        availableDatasets.push_back(info.id);
+    }
+    datasetInfos.swap(usable);
+
+    if (availableDatasets.empty())
+    {
+        std::cerr << "Error in KittiConfig: No data sets were found in "
+                  << rootPath.string() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+const KittiDatasetInfo* KittiConfig::getDatasetInfo(int dataset)
+{
+    for (std::size_t i = 0; i < datasetInfos.size(); ++i)
+    {
+        if (datasetInfos[i].id == dataset)
+        {
+            return &datasetInfos[i];
+        }
+    }
+    return NULL;
+}
+
+std::string KittiConfig::getDatasetName(int dataset)
+{
+    const KittiDatasetInfo* info = getDatasetInfo(dataset);
+    if (!info)
+        return (boost::format("%|04|") % dataset).str();
+    if (info->date.empty())
+        return (boost::format("%|04|") % info->number).str();
+    return (boost::format("%s_drive_%04d") % info->date % info->number).str();
+}
+
+boost::filesystem::path KittiConfig::getDatasetPath(int dataset)
+{
+    const KittiDatasetInfo* info = getDatasetInfo(dataset);
+    if (info)
+    {
+        return info->directory;
+    }
     return boost::filesystem::path(data_directory)
             / raw_data_directory
             / (boost::format(dataset_folder_template) % dataset).str()
+            ;
+}
+
+boost::filesystem::path KittiConfig::getPointCloudPath(int dataset)
+{
+    return getPointCloudPath(getDatasetPath(dataset));
+}
+
+boost::filesystem::path KittiConfig::getPointCloudPath(const boost::filesystem::path& datasetPath)
+{
+    return datasetPath
             / point_cloud_directory
             ;
 }
 
+std::string KittiConfig::getPointCloudFileExtension()
+{
+    return boost::filesystem::path(point_cloud_file_template).extension().string();
+}
+
 boost::filesystem::path KittiConfig::getPointCloudPath(int dataset, int frameId)
 {
-    return getPointCloudPath(dataset)
-            / (boost::format(point_cloud_file_template) % frameId).str()
-            ;
+    return getPointCloudPathTemplate(dataset).get(frameId);
+}
+
+KittiPathTemplate KittiConfig::getPointCloudPathTemplate(int dataset)
+{
+    return KittiPathTemplate(getPointCloudPath(dataset), point_cloud_file_template);
 }
 
 boost::filesystem::path KittiConfig::getTrackletsPath(int dataset)
 {
-    return boost::filesystem::path(data_directory)
-            / raw_data_directory
-            / (boost::format(dataset_folder_template) % dataset).str()
+    return getTrackletsPath(getDatasetPath(dataset));
+}
+
+boost::filesystem::path KittiConfig::getTrackletsPath(const boost::filesystem::path& datasetPath)
+{
+    return datasetPath
             / tracklets_directory
             / tracklets_file_name
             ;
 }
 
-boost::filesystem::path KittiConfig::getImagePath(int dataset)
+boost::filesystem::path KittiConfig::getSequenceArchivePath(int dataset)
 {
+    return getSequenceArchivePath(getDatasetPath(dataset));
+}
 
-    return boost::filesystem::path(data_directory)
-        / raw_data_directory
-        / (boost::format(dataset_folder_template) % dataset).str()
-        / image_directory
-        ;
+boost::filesystem::path KittiConfig::getSequenceArchivePath(const boost::filesystem::path& datasetPath)
+{
+    return datasetPath
+            / sequence_archive_file_name
+            ;
 }
-boost::filesystem::path KittiConfig::getImagePath(int dataset, int frameId)
+
+void KittiConfig::setSequenceArchiveEnabled(bool enabled)
 {
+    sequence_archive_enabled = enabled;
+}
 
-    return getImagePath(dataset) 
-        / (boost::format(image_file_template) % frameId).str()
+bool KittiConfig::isSequenceArchiveEnabled()
+{
+    return sequence_archive_enabled;
+}
+
+boost::filesystem::path KittiConfig::getTrackletsCachePath(int dataset)
+{
+    return getDatasetPath(dataset)
+            / tracklets_directory
+            / tracklets_cache_file_name
+            ;
+}
+
+std::vector<boost::filesystem::path> KittiConfig::getFrameIndexCachePaths(int dataset)
+{
+    std::vector<boost::filesystem::path> paths;
+    paths.push_back(getDatasetPath(dataset) / frame_index_file_name);
+
+    // Several data directories may hold the same drive number, so name the
+    // per user copy after the point cloud folder
+    boost::filesystem::path userCacheDirectory = getUserCacheDirectory();
+    if (!userCacheDirectory.empty())
+    {
+        boost::uint64_t hash = kittiHash(getPointCloudPath(dataset).generic_string());
+        paths.push_back(userCacheDirectory
+                        / (boost::format("%|04|_%|x|.cache") % dataset % hash).str());
+    }
+    return paths;
+}
+
+boost::filesystem::path KittiConfig::getUserCacheDirectory()
+{
+    const char* cacheHome = std::getenv("XDG_CACHE_HOME");
+    if (cacheHome && *cacheHome)
+        return boost::filesystem::path(cacheHome) / "qt-kitti-visualizer";
+    const char* localAppData = std::getenv("LOCALAPPDATA");
+    if (localAppData && *localAppData)
+        return boost::filesystem::path(localAppData) / "qt-kitti-visualizer";
+    const char* home = std::getenv("HOME");
+    if (home && *home)
+        return boost::filesystem::path(home) / ".cache" / "qt-kitti-visualizer";
+    return boost::filesystem::path();
+}
+
+boost::filesystem::path KittiConfig::getImagePath(int dataset, int camera)
+{
+    return getImagePath(getDatasetPath(dataset), camera);
+}
+
+boost::filesystem::path KittiConfig::getImagePath(const boost::filesystem::path& datasetPath, int camera)
+{
+    return datasetPath
+        / image_directories[camera]
         ;
 }
 
+boost::filesystem::path KittiConfig::getImagePath(int dataset, int camera, int frameId)
+{
+    return getImagePathTemplate(dataset, camera).get(frameId);
+}
+
+KittiPathTemplate KittiConfig::getImagePathTemplate(int dataset, int camera)
+{
+    return KittiPathTemplate(getImagePath(dataset, camera), image_file_templates[camera]);
+}
+
+boost::filesystem::path KittiConfig::getOxtsPath(int dataset)
+{
+    return getOxtsPath(getDatasetPath(dataset));
+}
+
+boost::filesystem::path KittiConfig::getOxtsPath(const boost::filesystem::path& datasetPath)
+{
+    return datasetPath
+            / oxts_directory
+            ;
+}
+
+KittiPathTemplate KittiConfig::getOxtsPathTemplate(int dataset)
+{
+    return KittiPathTemplate(getOxtsPath(dataset), oxts_file_template);
+}
+
+boost::filesystem::path KittiConfig::getCalibrationPath(int dataset)
+{
+    return getDatasetPath(dataset).parent_path();
+}
+
+boost::filesystem::path KittiConfig::getImuToVeloCalibrationPath(int dataset)
+{
+    return getCalibrationPath(dataset)
+            / imu_to_velo_calibration_file_name
+            ;
+}
+
+boost::filesystem::path KittiConfig::getVeloToCamCalibrationPath(int dataset)
+{
+    return getCalibrationPath(dataset)
+            / velo_to_cam_calibration_file_name
+            ;
+}
+
+boost::filesystem::path KittiConfig::getCamToCamCalibrationPath(int dataset)
+{
+    return getCalibrationPath(dataset)
+            / cam_to_cam_calibration_file_name
+            ;
+}
+
 
 int KittiConfig::getDatasetNumber(int index)
 {
@@ -104,27 +449,3 @@ int KittiConfig::getDatasetIndex(int number)
     std::cerr << "No such data set number: " << number << std::endl;
     return 0;
 }
-
-std::vector<int> KittiConfig::initAvailableDatasets()
-{
-    std::vector<int> datasets;
-    datasets.push_back(1);
-    datasets.push_back(2);
-    datasets.push_back(5);
-    datasets.push_back(9);
-    datasets.push_back(11);
-    datasets.push_back(13);
-    datasets.push_back(14);
-    datasets.push_back(17);
-    datasets.push_back(18);
-    datasets.push_back(48);
-    datasets.push_back(51);
-    datasets.push_back(56);
-    datasets.push_back(57);
-    datasets.push_back(59);
-    datasets.push_back(60);
-    datasets.push_back(84);
-    datasets.push_back(91);
-    datasets.push_back(93);
-    return datasets;
-}
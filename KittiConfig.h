@@ -24,12 +24,58 @@ limitations under the License.
 
 #include <boost/filesystem/path.hpp>
 
+#include "KittiDatasetManifest.h"
+
+/**
+ * @brief The KittiPathTemplate class
+ *
+ * Builds the file paths of the frames in one folder. The file name template
+ * is split once into the text around its frame number, so that getting a
+ * path only pastes the zero padded number between two precomputed strings.
+ * format() writes into a buffer owned by the caller; loops that keep the
+ * buffer do not allocate per frame.
+ *
+ * Templates with a single %|0N|, %0Nd, %d or %1% directive are precompiled,
+ * anything else is passed to boost::format on every call.
+ */
+class KittiPathTemplate
+{
+
+public:
+
+    KittiPathTemplate();
+    KittiPathTemplate(const boost::filesystem::path& directory, const std::string& fileTemplate);
+
+    void format(int frameId, std::string& path) const;
+    std::string get(int frameId) const;
+
+private:
+
+    std::string _file_template;
+    boost::filesystem::path _directory;
+    bool _compiled;
+    std::string _prefix;
+    std::string _suffix;
+    std::size_t _width;
+    char _fill;
+
+    void compile();
+};
+
 /**
  * @brief The KittiConfig class
  *
  * Define where the KITTI data sets are stored. Templated strings provide for a
  * high flexibility in storing and accessing your files.
  *
+ * The data sets are discovered at runtime, see KittiDatasetManifest. The list
+ * is kept in kitti_manifest.txt in the data directory and rebuilt when that
+ * file is missing or out of date, or a rescan is requested. The data
+ * directory defaults to the KITTI_DATA_DIRECTORY environment variable, if set.
+ *
+ * Data sets are identified by the id of their KittiDatasetInfo, which is the
+ * drive number as long as all drives were recorded on the same date.
+ *
  * The predefined values assume the following filesystem hierarchy:
  *
  * /QtKittiVisualizer (source)
@@ -40,7 +86,18 @@ limitations under the License.
  *       /velodyne_points
  *         /data
  *           /%|010|.bin (point clouds, e.g. 0000000000.bin)
+ *       /velodyne_points.kseq (all point clouds in one file, used instead of the .bin files if present)
+ *       /image_0%|1| (rectified cameras 0 to 3, grayscale 0 and 1, color 2 and 3)
+ *         /data
+ *           /%|010|.png (images, e.g. 0000000000.png)
+ *       /oxts
+ *         /data
+ *           /%|010|.txt (GPS/IMU packets, e.g. 0000000000.txt)
  *       /tracklet_labels.xml (tracklets)
+ *       /tracklet_labels.cache (binary copy of the tracklets, created on first load)
+ *     /calib_imu_to_velo.txt (calibration of the recording date, next to its drives)
+ *     /calib_velo_to_cam.txt
+ *     /calib_cam_to_cam.txt
  *
  * You can change the predefined values to your needs in KittiConfig.cpp.
  */
@@ -49,14 +106,58 @@ class KittiConfig
 
 public:
 
+    static void setDataDirectory(const std::string& directory);
+    static const std::string& getDataDirectory();
+    /** Fills availableDatasets from the manifest, or by scanning the data directory */
+    static bool initAvailableDatasets(bool rescan);
+    /** Returns NULL if the data set was not discovered */
+    static const KittiDatasetInfo* getDatasetInfo(int dataset);
+    /** The drive folder name without "_sync", e.g. "2011_09_26_drive_0001", for messages */
+    static std::string getDatasetName(int dataset);
+    static boost::filesystem::path getDatasetPath(int dataset);
+
     static boost::filesystem::path getPointCloudPath(int dataset);
     static boost::filesystem::path getPointCloudPath(int dataset,int frameId);
+    static KittiPathTemplate getPointCloudPathTemplate(int dataset);
+    /** The KittiSequenceArchive with the point clouds of a data set */
+    static boost::filesystem::path getSequenceArchivePath(int dataset);
+    /** Whether data sets read their point clouds from a sequence archive, if there is one */
+    static void setSequenceArchiveEnabled(bool enabled);
+    static bool isSequenceArchiveEnabled();
     static boost::filesystem::path getTrackletsPath(int dataset);
-    static boost::filesystem::path getImagePath(int dataset);
-    static boost::filesystem::path getImagePath(int dataset, int frameId);
-
-    /** Contains the numbers of data sets available from your data set folder */
-    static const std::vector<int> availableDatasets;
+    static boost::filesystem::path getTrackletsCachePath(int dataset);
+    /** Places to keep the frame index of a data set, in order of preference */
+    static std::vector<boost::filesystem::path> getFrameIndexCachePaths(int dataset);
+    /** Per user folder for caches that cannot be written next to the data */
+    static boost::filesystem::path getUserCacheDirectory();
+    /** Number of cameras of the recording platform, image_00 to image_03 */
+    static const int numberOfCameras = 4;
+    static boost::filesystem::path getImagePath(int dataset, int camera);
+    static boost::filesystem::path getImagePath(int dataset, int camera, int frameId);
+    static KittiPathTemplate getImagePathTemplate(int dataset, int camera);
+    static boost::filesystem::path getOxtsPath(int dataset);
+    static KittiPathTemplate getOxtsPathTemplate(int dataset);
+    /** The folder with the calibration files of the recording date of a data set */
+    static boost::filesystem::path getCalibrationPath(int dataset);
+    static boost::filesystem::path getImuToVeloCalibrationPath(int dataset);
+    static boost::filesystem::path getVeloToCamCalibrationPath(int dataset);
+    static boost::filesystem::path getCamToCamCalibrationPath(int dataset);
+
+    /**
+     * The folders and files of a drive by its folder, for drives that are not
+     * data sets yet, as while KittiDatasetManifest searches the data
+     * directory. The getters above return the same paths for data sets.
+     */
+    static boost::filesystem::path getPointCloudPath(const boost::filesystem::path& datasetPath);
+    /** The extension of the point cloud files, e.g. ".bin" */
+    static std::string getPointCloudFileExtension();
+    static boost::filesystem::path getSequenceArchivePath(const boost::filesystem::path& datasetPath);
+    static boost::filesystem::path getImagePath(const boost::filesystem::path& datasetPath, int camera);
+    static boost::filesystem::path getOxtsPath(const boost::filesystem::path& datasetPath);
+    static boost::filesystem::path getTrackletsPath(const boost::filesystem::path& datasetPath);
+
+    /** Contains the ids of data sets available from your data set folder */
+    static std::vector<int> availableDatasets;
     static int getDatasetNumber(int index);
     static int getDatasetIndex(int number);
 
@@ -69,12 +170,22 @@ private:
     static std::string dataset_folder_template;
     static std::string point_cloud_directory;
     static std::string point_cloud_file_template;
-    static std::string image_directory;
-    static std::string image_file_template;
+    static std::string sequence_archive_file_name;
+    static bool sequence_archive_enabled;
+    static std::string image_directories[numberOfCameras];
+    static std::string image_file_templates[numberOfCameras];
+    static std::string oxts_directory;
+    static std::string oxts_file_template;
+    static std::string imu_to_velo_calibration_file_name;
+    static std::string velo_to_cam_calibration_file_name;
+    static std::string cam_to_cam_calibration_file_name;
     static std::string tracklets_directory;
     static std::string tracklets_file_name;
+    static std::string tracklets_cache_file_name;
+    static std::string manifest_file_name;
+    static std::string frame_index_file_name;
 
-    static std::vector<int> initAvailableDatasets();
+    static std::vector<KittiDatasetInfo> datasetInfos;
 };
 
 #endif // KITTICONFIG_H
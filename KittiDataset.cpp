@@ -17,13 +17,19 @@ limitations under the License.
 */
 
 #include "KittiDataset.h"
+#include "KittiCalibration.h"
+#include "KittiTrackletCache.h"
 
+#include <algorithm>
+#include <cmath>
+#include <ctime>
 #include <string>
 #include <vector>
 
 #include <boost/filesystem/operations.hpp>
 #include <boost/filesystem/path.hpp>
 #include <boost/format.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
 
 #include <pcl/filters/crop_box.h>
 #include <pcl/common/io.h>
@@ -31,35 +37,94 @@ limitations under the License.
 #include <pcl/search/kdtree.h>
 
 #include <eigen3/Eigen/Core>
+#include <eigen3/Eigen/Geometry>
+
+namespace
+{
+
+/** Same box as pcl::CropBox in KittiDataset::getTrackletPointCloud() */
+KittiOrientedBox getTrackletBox(const KittiTracklet& tracklet, const Tracklets::tPose& tpose)
+{
+    return KittiOrientedBox(Eigen::Vector3f((float) tpose.tx, (float) tpose.ty, (float) tpose.tz + tracklet.h / 2.0f),
+                            Eigen::Vector3f((float) tpose.rx, (float) tpose.ry, (float) tpose.rz),
+                            Eigen::Vector3f(tracklet.l / 2.0f, tracklet.w / 2.0f, tracklet.h / 2.0f));
+}
+
+/**
+ * Up to this many boxes, one KittiBoxKernel pass per box beats the single
+ * KittiBoxGrid pass over a frame of 120000 points. The grid pass is bound by
+ * branches on the point positions, the vector passes are not.
+ */
+int getMaxKernelBoxes()
+{
+    switch (KittiBoxKernel::getInstructionSet())
+    {
+    case KittiBoxKernel::AVX2:
+        return 96;
+    case KittiBoxKernel::SSE2:
+        return 24;
+    default:
+        return 4;
+    }
+}
+
+}
 
 KittiDataset::KittiDataset(int dataset) :
     _dataset(dataset),
-    _number_of_frames(0)
+    _number_of_frames(0),
+    _point_cloud_path_template(KittiConfig::getPointCloudPathTemplate(dataset)),
+    // Enough for the frames a prefetcher releases at once, and their tracklets
+    _point_frame_pool(16),
+    _tracklet_frame_pool(512),
+    _point_cloud_pool(16)
 {
-    if (!boost::filesystem::exists(KittiConfig::getPointCloudPath(_dataset)))
+    for (int camera = 0; camera < KittiConfig::numberOfCameras; ++camera)
+        _image_path_templates.push_back(KittiConfig::getImagePathTemplate(dataset, camera));
+
+    // The .bin files are indexed even with an archive, to tell if it is stale
+    bool hasPointCloudPath = boost::filesystem::exists(KittiConfig::getPointCloudPath(_dataset));
+    if (hasPointCloudPath)
+    {
+        initNumberOfFrames();
+    }
+    if (initSequenceArchive())
+    {
+        _number_of_frames = _sequence_archive.getNumberOfFrames();
+    }
+    else if (!hasPointCloudPath)
     {
         std::cerr << "Error in KittiDataset: Data set path "
                   << (KittiConfig::getPointCloudPath(_dataset)).string()
                   << " does not exist!" << std::endl;
         return;
     }
-    if (!boost::filesystem::exists(KittiConfig::getPointCloudPath(_dataset, 0)))
+
+    if (_sequence_archive.isOpen() ? !_sequence_archive.hasFrame(0) : !_frame_index.hasFrame(0))
     {
         std::cerr << "Error in KittiDataset: No point cloud was found at "
                   << (KittiConfig::getPointCloudPath(_dataset, 0)).string()
                   << std::endl;
+        _number_of_frames = 0;
         return;
     }
+    // Not every discovered drive is labelled; show such drives without boxes.
     if (!boost::filesystem::exists(KittiConfig::getTrackletsPath(_dataset)))
     {
-        std::cerr << "Error in KittiDataset: No tracklets were found at "
+        std::cerr << "Warning in KittiDataset: No tracklets were found at "
                   << (KittiConfig::getTrackletsPath(_dataset)).string()
                   << std::endl;
-        return;
     }
+    else
+    {
+        initTracklets();
+    }
+    initActiveTracklets();
+}
 
-    initNumberOfFrames();
-    initTracklets();
+int KittiDataset::getDatasetNumber()
+{
+    return _dataset;
 }
 
 int KittiDataset::getNumberOfFrames()
@@ -69,25 +134,94 @@ int KittiDataset::getNumberOfFrames()
 
 KittiPointCloud::Ptr KittiDataset::getPointCloud(int frameId)
 {
-    KittiPointCloud::Ptr cloud(new KittiPointCloud);
-    std::fstream file(KittiConfig::getPointCloudPath(_dataset, frameId).c_str(), std::ios::in | std::ios::binary);
-    if(file.good()){
-        file.seekg(0, std::ios::beg);
-        int i;
-        for (i = 0; file.good() && !file.eof(); i++) {
-            KittiPoint point;
-            file.read((char *) &point.x, 3*sizeof(float));
-            file.read((char *) &point.intensity, sizeof(float));
-            cloud->push_back(point);
-        }
-        file.close();
-    }
+    KittiPointCloud::Ptr cloud = _point_cloud_pool.acquire();
+    getPointFrame(frameId)->toPointCloud(*cloud);
     return cloud;
 }
 
-std::string KittiDataset::getImageFileName(int frameId)
+KittiPointFrame::Ptr KittiDataset::getPointFrame(int frameId)
 {
-    return std::string(KittiConfig::getImagePath(_dataset, frameId).string());
+    KittiPointFrame::Ptr pointFrame = _point_frame_pool.acquire();
+    getPointFrame(frameId, *pointFrame);
+    return pointFrame;
+}
+
+bool KittiDataset::getPointFrame(int frameId, KittiPointFrame& pointFrame)
+{
+    if (_sequence_archive.isOpen())
+        return _sequence_archive.readFrame(frameId, pointFrame, _decode_pool.get());
+
+    // Velodyne scans are stored as packed x, y, z, reflectance float records.
+    // Map the whole file once and size the frame from the file length instead
+    // of growing it point by point. Gaps in the drive are known from the
+    // frame index and need no file system access.
+    if (_frame_index.getFileSize(frameId) < 4 * sizeof(float))
+    {
+        pointFrame.clear();
+        return false;
+    }
+    std::string pointCloudPath;
+    _point_cloud_path_template.format(frameId, pointCloudPath);
+
+    boost::iostreams::mapped_file_source file;
+    try
+    {
+        file.open(pointCloudPath);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Error in KittiDataset: Could not map point cloud "
+                  << pointCloudPath << ": " << e.what() << std::endl;
+        pointFrame.clear();
+        return false;
+    }
+
+    const std::size_t numberOfPoints = file.size() / (4 * sizeof(float));
+    const float* data = reinterpret_cast<const float*>(file.data());
+    pointFrame.resize(numberOfPoints);
+    float* x = pointFrame.x();
+    float* y = pointFrame.y();
+    float* z = pointFrame.z();
+    float* intensity = pointFrame.intensity();
+    for (std::size_t i = 0; i < numberOfPoints; ++i, data += 4)
+    {
+        x[i] = data[0];
+        y[i] = data[1];
+        z[i] = data[2];
+        intensity[i] = data[3];
+    }
+    return true;
+}
+
+bool KittiDataset::hasSequenceArchive() const
+{
+    return _sequence_archive.isOpen();
+}
+
+void KittiDataset::setDecodeThreads(int numberOfThreads)
+{
+    if (numberOfThreads <= 1)
+        _decode_pool.reset();
+    else if (!_decode_pool || _decode_pool->getNumberOfThreads() != numberOfThreads)
+        _decode_pool.reset(new KittiThreadPool(numberOfThreads));
+}
+
+bool KittiDataset::hasImages(int camera)
+{
+    const KittiDatasetInfo::Stream streams[KittiConfig::numberOfCameras] = {
+        KittiDatasetInfo::IMAGE_00, KittiDatasetInfo::IMAGE_01,
+        KittiDatasetInfo::IMAGE_02, KittiDatasetInfo::IMAGE_03
+    };
+    if (camera < 0 || camera >= KittiConfig::numberOfCameras)
+        return false;
+    // Data sets that were not discovered are tried anyway
+    const KittiDatasetInfo* info = KittiConfig::getDatasetInfo(_dataset);
+    return !info || info->hasStream(streams[camera]);
+}
+
+std::string KittiDataset::getImageFileName(int camera, int frameId)
+{
+    return _image_path_templates.at(camera).get(frameId);
 }
 
 KittiPointCloud::Ptr KittiDataset::getTrackletPointCloud(KittiPointCloud::Ptr& pointCloud, const KittiTracklet& tracklet, int frameId)
@@ -100,7 +234,7 @@ KittiPointCloud::Ptr KittiDataset::getTrackletPointCloud(KittiPointCloud::Ptr& p
     Eigen::Vector3f boxTranslation((float) tpose.tx, (float) tpose.ty, (float) tpose.tz + tracklet.h / 2.0f);
     Eigen::Vector3f boxRotation((float) tpose.rx, (float) tpose.ry, (float) tpose.rz);
 
-    KittiPointCloud::Ptr trackletPointCloud(new KittiPointCloud());
+    KittiPointCloud::Ptr trackletPointCloud = _point_cloud_pool.acquire();
     pcl::CropBox<KittiPoint> cropFilter;
     cropFilter.setInputCloud(pointCloud);
     cropFilter.setMin(minPoint);
@@ -112,11 +246,201 @@ KittiPointCloud::Ptr KittiDataset::getTrackletPointCloud(KittiPointCloud::Ptr& p
     return trackletPointCloud;
 }
 
+void KittiDataset::getTrackletPointIndices(const KittiPointFrame& pointFrame, int frameId, std::vector<std::vector<int> >& indices)
+{
+    KittiActiveTracklets tracklets = getActiveTracklets(frameId);
+    if (tracklets.size() <= getMaxKernelBoxes())
+    {
+        indices.resize(tracklets.size());
+        for (int i = 0; i < tracklets.size(); ++i)
+        {
+            getTrackletPointIndices(pointFrame, tracklets.at(i), frameId, indices[i]);
+        }
+        return;
+    }
+
+    KittiBoxGrid grid;
+    initTrackletGrid(tracklets, frameId, grid);
+    grid.collect(pointFrame, indices);
+}
+
+void KittiDataset::getTrackletPointIndices(const KittiPointFrame& pointFrame, const KittiTracklet& tracklet, int frameId, std::vector<int>& indices)
+{
+    indices.clear();
+    const Tracklets::tPose& tpose = tracklet.poses.at(frameId - tracklet.first_frame);
+    KittiOrientedBox box = getTrackletBox(tracklet, tpose);
+    if (box.yawOnly)
+    {
+        KittiBoxKernel::collect(pointFrame.x(), pointFrame.y(), pointFrame.z(), pointFrame.size(), box.yawBox, indices);
+        return;
+    }
+
+    // Not a yaw-only box, test with the full rotation
+    for (std::size_t i = 0; i < pointFrame.size(); ++i)
+    {
+        if (box.contains(pointFrame.x()[i], pointFrame.y()[i], pointFrame.z()[i]))
+            indices.push_back((int) i);
+    }
+}
+
+void KittiDataset::initTrackletGrid(const KittiActiveTracklets& tracklets, int frameId, KittiBoxGrid& grid)
+{
+    std::vector<KittiOrientedBox> boxes(tracklets.size());
+    for (int i = 0; i < tracklets.size(); ++i)
+    {
+        const KittiTracklet& tracklet = tracklets.at(i);
+        boxes[i] = getTrackletBox(tracklet, tracklet.poses.at(frameId - tracklet.first_frame));
+    }
+    grid.setBoxes(boxes);
+}
+
+void KittiDataset::getTrackletPointFrame(const KittiPointFrame& pointFrame, const KittiTracklet& tracklet, int frameId,
+                                         KittiBoxKernel::OutputFrame outputFrame, const Eigen::Vector3f& offset,
+                                         KittiPointFrame& trackletFrame, std::vector<int>* indices)
+{
+    const Tracklets::tPose& tpose = tracklet.poses.at(frameId - tracklet.first_frame);
+    KittiOrientedBox box = getTrackletBox(tracklet, tpose);
+    if (box.yawOnly)
+    {
+        KittiBoxKernel::crop(pointFrame, box.yawBox, outputFrame, offset[0], offset[1], offset[2], trackletFrame, indices);
+        return;
+    }
+
+    // Not a yaw-only box, test and transform with the full rotation
+    trackletFrame.clear();
+    if (indices)
+        indices->clear();
+    for (std::size_t i = 0; i < pointFrame.size(); ++i)
+    {
+        Eigen::Vector3f point(pointFrame.x()[i], pointFrame.y()[i], pointFrame.z()[i]);
+        if (!box.contains(point[0], point[1], point[2]))
+            continue;
+        if (outputFrame == KittiBoxKernel::BOX_FRAME)
+            point = box.toBox * (point - box.center);
+        point += offset;
+        trackletFrame.push_back(point[0], point[1], point[2], pointFrame.intensity()[i]);
+        if (indices)
+            indices->push_back((int) i);
+    }
+}
+
+void KittiDataset::getTrackletPointFrame(const KittiPointFrame& pointFrame, const std::vector<int>& indices,
+                                         const KittiTracklet& tracklet, int frameId,
+                                         KittiBoxKernel::OutputFrame outputFrame, const Eigen::Vector3f& offset,
+                                         KittiPointFrame& trackletFrame)
+{
+    KittiOrientedBox box = getTrackletBox(tracklet, tracklet.poses.at(frameId - tracklet.first_frame));
+    trackletFrame.resize(indices.size());
+    for (std::size_t j = 0; j < indices.size(); ++j)
+    {
+        int i = indices[j];
+        float x = pointFrame.x()[i];
+        float y = pointFrame.y()[i];
+        float z = pointFrame.z()[i];
+        if (outputFrame == KittiBoxKernel::BOX_FRAME)
+        {
+            // The same coordinates as the kernel and the full rotation above
+            if (box.yawOnly)
+            {
+                box.yawBox.contains(pointFrame.x()[i], pointFrame.y()[i], pointFrame.z()[i], x, y, z);
+            }
+            else
+            {
+                Eigen::Vector3f local = box.toBox * (Eigen::Vector3f(x, y, z) - box.center);
+                x = local[0];
+                y = local[1];
+                z = local[2];
+            }
+        }
+        trackletFrame.x()[j] = x + offset[0];
+        trackletFrame.y()[j] = y + offset[1];
+        trackletFrame.z()[j] = z + offset[2];
+        trackletFrame.intensity()[j] = pointFrame.intensity()[i];
+    }
+}
+
+KittiPointFrame::Ptr KittiDataset::getTrackletPointFrame(const KittiPointFrame& pointFrame, const KittiTracklet& tracklet, int frameId,
+                                                        KittiBoxKernel::OutputFrame outputFrame, const Eigen::Vector3f& offset,
+                                                        std::vector<int>* indices)
+{
+    KittiPointFrame::Ptr trackletFrame = _tracklet_frame_pool.acquire();
+    getTrackletPointFrame(pointFrame, tracklet, frameId, outputFrame, offset, *trackletFrame, indices);
+    return trackletFrame;
+}
+
+KittiPointFrame::Ptr KittiDataset::getTrackletPointFrame(const KittiPointFrame& pointFrame, const std::vector<int>& indices,
+                                                        const KittiTracklet& tracklet, int frameId,
+                                                        KittiBoxKernel::OutputFrame outputFrame, const Eigen::Vector3f& offset)
+{
+    KittiPointFrame::Ptr trackletFrame = _tracklet_frame_pool.acquire();
+    getTrackletPointFrame(pointFrame, indices, tracklet, frameId, outputFrame, offset, *trackletFrame);
+    return trackletFrame;
+}
+
+std::size_t KittiDataset::getBufferAllocations() const
+{
+    return _point_frame_pool.getStatistics().allocated
+            + _tracklet_frame_pool.getStatistics().allocated
+            + _point_cloud_pool.getStatistics().allocated;
+}
+
 Tracklets& KittiDataset::getTracklets()
 {
     return _tracklets;
 }
 
+const KittiPoseTable& KittiDataset::getPoses()
+{
+    std::call_once(_poses_loaded, &KittiDataset::initPoses, this);
+    return _poses;
+}
+
+void KittiDataset::initPoses()
+{
+    const KittiDatasetInfo* info = KittiConfig::getDatasetInfo(_dataset);
+    if (info && !info->hasStream(KittiDatasetInfo::OXTS))
+    {
+        std::cerr << "Warning in KittiDataset: Data set " << _dataset
+                  << " has no OXTS data, frames have no poses" << std::endl;
+        return;
+    }
+
+    // The IMU sits about 80 cm behind the Velodyne; without the calibration
+    // the accumulated sweeps are slightly off in turns only
+    Eigen::Affine3d imuToVelo = Eigen::Affine3d::Identity();
+    KittiCalibration::Values calibration;
+    if (!KittiCalibration::read(KittiConfig::getImuToVeloCalibrationPath(_dataset), calibration)
+            || !KittiCalibration::getRigidTransform(calibration, "R", "T", imuToVelo))
+    {
+        std::cerr << "Warning in KittiDataset: Could not read "
+                  << KittiConfig::getImuToVeloCalibrationPath(_dataset).string()
+                  << ", assuming the IMU at the Velodyne" << std::endl;
+    }
+
+    if (!_poses.load(KittiConfig::getOxtsPathTemplate(_dataset), _number_of_frames, imuToVelo))
+    {
+        std::cerr << "Warning in KittiDataset: No OXTS packets were found at "
+                  << KittiConfig::getOxtsPath(_dataset).string() << std::endl;
+    }
+}
+
+KittiCameraCalibration::ConstPtr KittiDataset::getCameraCalibration()
+{
+    return KittiCalibration::getCameraCalibration(KittiConfig::getVeloToCamCalibrationPath(_dataset),
+                                                  KittiConfig::getCamToCamCalibrationPath(_dataset));
+}
+
+KittiActiveTracklets KittiDataset::getActiveTracklets(int frameId)
+{
+    if (frameId < 0 || frameId + 1 >= (int) _active_tracklet_offsets.size())
+    {
+        return KittiActiveTracklets();
+    }
+    int begin = _active_tracklet_offsets[frameId];
+    int end = _active_tracklet_offsets[frameId + 1];
+    return KittiActiveTracklets(&_tracklets, _active_tracklet_ids.data() + begin, end - begin);
+}
+
 int KittiDataset::getLabel(const char* labelString)
 {
     if (strcmp(labelString, "Car") == 0)
@@ -291,23 +615,119 @@ std::string KittiDataset::getLabelString(int label)
 
 void KittiDataset::initNumberOfFrames()
 {
-    boost::filesystem::directory_iterator dit(KittiConfig::getPointCloudPath(_dataset));
-    boost::filesystem::directory_iterator eit;
+    if (!_frame_index.init(KittiConfig::getPointCloudPath(_dataset),
+                           KittiConfig::getFrameIndexCachePaths(_dataset)))
+    {
+        std::cerr << "Error in KittiDataset: Could not list the point clouds in "
+                  << KittiConfig::getPointCloudPath(_dataset).string() << std::endl;
+        return;
+    }
 
-    while(dit != eit)
+    _number_of_frames = _frame_index.getNumberOfFrames();
+    if (!_frame_index.getMissingFrames().empty())
     {
-        if(boost::filesystem::is_regular_file(*dit) && dit->path().extension() == ".bin")
-        {
-            _number_of_frames++;
-        }
-        ++dit;
+        std::cerr << "Warning in KittiDataset: " << _frame_index.getMissingFrames().size()
+                  << " of " << _number_of_frames << " point clouds of data set "
+                  << _dataset << " are missing, the first is frame "
+                  << _frame_index.getMissingFrames().front() << std::endl;
     }
 }
 
+bool KittiDataset::initSequenceArchive()
+{
+    if (!KittiConfig::isSequenceArchiveEnabled())
+        return false;
+    boost::system::error_code error;
+    boost::filesystem::path archivePath = KittiConfig::getSequenceArchivePath(_dataset);
+    if (!boost::filesystem::is_regular_file(archivePath, error))
+        return false;
+    // A broken archive is reported, the .bin files are used instead
+    if (!_sequence_archive.open(archivePath))
+        return false;
+
+    // Without the .bin files the archive is all there is
+    boost::filesystem::path pointCloudPath = KittiConfig::getPointCloudPath(_dataset);
+    if (!boost::filesystem::is_directory(pointCloudPath, error))
+        return true;
+
+    // Scans added or removed after the archive was written update the
+    // modification time of their directory
+    std::time_t archiveTime = boost::filesystem::last_write_time(archivePath, error);
+    std::time_t pointCloudTime = error ? 0 : boost::filesystem::last_write_time(pointCloudPath, error);
+    if (error || pointCloudTime > archiveTime
+            || _sequence_archive.getNumberOfFrames() != _frame_index.getNumberOfFrames())
+    {
+        std::cerr << "Warning in KittiDataset: Sequence archive " << archivePath.string()
+                  << " does not match the point clouds in " << pointCloudPath.string()
+                  << ", reading those instead" << std::endl;
+        _sequence_archive.close();
+        return false;
+    }
+    return true;
+}
+
 void KittiDataset::initTracklets()
 {
     boost::filesystem::path trackletsPath = KittiConfig::getTrackletsPath(_dataset);
-    _tracklets.loadFromFile(trackletsPath.string());
+    boost::filesystem::path cachePath = KittiConfig::getTrackletsCachePath(_dataset);
+    if (KittiTrackletCache::load(cachePath, trackletsPath, _tracklets))
+    {
+        return;
+    }
+
+    if (!_tracklets.loadFromFile(trackletsPath.string()))
+    {
+        std::cerr << "Error in KittiDataset: Could not parse tracklets "
+                  << trackletsPath.string() << std::endl;
+        return;
+    }
+    if (!KittiTrackletCache::save(cachePath, trackletsPath, _tracklets))
+    {
+        std::cerr << "Warning in KittiDataset: Could not write tracklet cache "
+                  << cachePath.string() << std::endl;
+    }
+}
+
+void KittiDataset::initActiveTracklets()
+{
+    int number_of_tracklets = _tracklets.numberOfTracklets();
+    int number_of_frames = _number_of_frames;
+    for (int tracklet_id = 0; tracklet_id < number_of_tracklets; ++tracklet_id)
+    {
+        const KittiTracklet& tracklet = *_tracklets.getTracklet(tracklet_id);
+        number_of_frames = std::max(number_of_frames, tracklet.first_frame + (int) tracklet.poses.size());
+    }
+
+    // Count the active tracklets per frame, then turn the counts into offsets
+    _active_tracklet_offsets.assign(number_of_frames + 1, 0);
+    for (int tracklet_id = 0; tracklet_id < number_of_tracklets; ++tracklet_id)
+    {
+        const KittiTracklet& tracklet = *_tracklets.getTracklet(tracklet_id);
+        int first_frame = std::max(tracklet.first_frame, 0);
+        int end_frame = tracklet.first_frame + (int) tracklet.poses.size();
+        for (int frame = first_frame; frame < end_frame; ++frame)
+        {
+            _active_tracklet_offsets[frame + 1]++;
+        }
+    }
+    for (int frame = 0; frame < number_of_frames; ++frame)
+    {
+        _active_tracklet_offsets[frame + 1] += _active_tracklet_offsets[frame];
+    }
+
+    // Fill in the ids, in ascending order within each frame
+    _active_tracklet_ids.resize(_active_tracklet_offsets[number_of_frames]);
+    std::vector<int> next(_active_tracklet_offsets.begin(), _active_tracklet_offsets.end() - 1);
+    for (int tracklet_id = 0; tracklet_id < number_of_tracklets; ++tracklet_id)
+    {
+        const KittiTracklet& tracklet = *_tracklets.getTracklet(tracklet_id);
+        int first_frame = std::max(tracklet.first_frame, 0);
+        int end_frame = tracklet.first_frame + (int) tracklet.poses.size();
+        for (int frame = first_frame; frame < end_frame; ++frame)
+        {
+            _active_tracklet_ids[next[frame]++] = tracklet_id;
+        }
+    }
 }
 
 //#undef DEBUG_OUTPUT_ENABLED
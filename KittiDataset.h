@@ -19,7 +19,9 @@ limitations under the License.
 #ifndef KITTIDATASET_H
 #define KITTIDATASET_H
 
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include <boost/filesystem.hpp>
 #include <boost/shared_ptr.hpp>
@@ -27,7 +29,18 @@ limitations under the License.
 #include <pcl/point_types.h>
 #include <pcl/point_cloud.h>
 
+#include <eigen3/Eigen/Core>
+
+#include "KittiBoxGrid.h"
+#include "KittiBoxKernel.h"
+#include "KittiBufferPool.h"
+#include "KittiCalibration.h"
 #include "KittiConfig.h"
+#include "KittiFrameIndex.h"
+#include "KittiPointFrame.h"
+#include "KittiPoseTable.h"
+#include "KittiSequenceArchive.h"
+#include "KittiThreadPool.h"
 
 #include "kitti-devkit-raw/tracklets.h"
 
@@ -35,18 +48,124 @@ typedef pcl::PointXYZI KittiPoint;
 typedef pcl::PointCloud<KittiPoint> KittiPointCloud;
 typedef Tracklets::tTracklet KittiTracklet;
 
-class KittiDataset
+/**
+ * @brief The tracklets active in one frame
+ *
+ * A lightweight view into the frame index of a KittiDataset. It stays valid as
+ * long as the data set it was obtained from.
+ */
+class KittiActiveTracklets
+{
+
+public:
+
+    KittiActiveTracklets() : _tracklets(NULL), _ids(NULL), _size(0) {}
+    KittiActiveTracklets(Tracklets* tracklets, const int* ids, int size) :
+        _tracklets(tracklets), _ids(ids), _size(size) {}
+
+    int size() const { return _size; }
+    /** Returns the id of the i-th active tracklet, see Tracklets::getTracklet() */
+    int id(int i) const { return _ids[i]; }
+    const KittiTracklet& at(int i) const { return *_tracklets->getTracklet(_ids[i]); }
+
+private:
+
+    Tracklets* _tracklets;
+    const int* _ids;
+    int _size;
+};
+
+/**
+ * @brief The KittiDataset class
+ *
+ * Point clouds and frames returned by this class come from buffer pools and
+ * return there when released, so playing a drive does not allocate a new
+ * buffer per frame once the pools are warm.
+ *
+ * The point clouds are read from the KittiSequenceArchive of the drive if
+ * there is one, see KittiConfig::getSequenceArchivePath(), and from the
+ * .bin file of each frame otherwise. An archive that is older than the
+ * .bin files or has another number of frames is ignored.
+ */
+class KittiDataset : private boost::noncopyable
 {
 
 public:
 
-    KittiDataset();
     KittiDataset(int dataset);
+    int getDatasetNumber();
+    /**
+     * Number of frames of the sequence archive, or else the highest frame
+     * number plus one from the KittiFrameIndex of the point cloud folder,
+     * including missing frames
+     */
     int getNumberOfFrames();
+    /** Copies the frame into a pooled PCL cloud; prefer getPointFrame() where PCL is not needed */
     KittiPointCloud::Ptr getPointCloud(int frameId);
-    std::string getImageFileName(int frameId);
+    KittiPointFrame::Ptr getPointFrame(int frameId);
+    /** Loads a frame into pointFrame, reusing its storage; empties it if the frame is missing */
+    bool getPointFrame(int frameId, KittiPointFrame& pointFrame);
+    /** Whether the point clouds come from a sequence archive */
+    bool hasSequenceArchive() const;
+    /**
+     * Threads that decode a compressed archive frame, including the loading
+     * one (default 1). Starts the decode pool of the data set, so call it
+     * before frames are read on other threads.
+     */
+    void setDecodeThreads(int numberOfThreads);
+    /** Whether the drive was recorded with the camera, see KittiConfig::numberOfCameras */
+    bool hasImages(int camera);
+    std::string getImageFileName(int camera, int frameId);
     KittiPointCloud::Ptr getTrackletPointCloud(KittiPointCloud::Ptr& pointCloud, const KittiTracklet& tracklet, int frameId);
+    /**
+     * Crops the points of all tracklets active in frameId. indices[i] receives
+     * the indices of the points inside the bounding box of
+     * getActiveTracklets(frameId).at(i). A few boxes are cropped one by one
+     * with the vectorized KittiBoxKernel; more boxes are tested in a single
+     * pass over the points with a KittiBoxGrid. Both find the same points.
+     */
+    void getTrackletPointIndices(const KittiPointFrame& pointFrame, int frameId, std::vector<std::vector<int> >& indices);
+    /**
+     * Finds the points inside the bounding box of one tracklet, like
+     * getTrackletPointCloud(), with the vectorized KittiBoxKernel. indices
+     * is cleared first.
+     */
+    void getTrackletPointIndices(const KittiPointFrame& pointFrame, const KittiTracklet& tracklet, int frameId, std::vector<int>& indices);
+    /**
+     * Copies the points inside the bounding box of one tracklet into
+     * trackletFrame in the same pass that finds them: either centered and
+     * unrotated (BOX_FRAME) or in place (POINT_FRAME), then moved by offset.
+     * indices optionally receives the indices of the copied points.
+     */
+    void getTrackletPointFrame(const KittiPointFrame& pointFrame, const KittiTracklet& tracklet, int frameId,
+                               KittiBoxKernel::OutputFrame outputFrame, const Eigen::Vector3f& offset,
+                               KittiPointFrame& trackletFrame, std::vector<int>* indices = NULL);
+    /**
+     * Like above, for points already found inside the box, e.g. the
+     * trackletPointIndices of a KittiFrame: copies and transforms only those
+     * points instead of testing the whole frame again.
+     */
+    void getTrackletPointFrame(const KittiPointFrame& pointFrame, const std::vector<int>& indices,
+                               const KittiTracklet& tracklet, int frameId,
+                               KittiBoxKernel::OutputFrame outputFrame, const Eigen::Vector3f& offset,
+                               KittiPointFrame& trackletFrame);
+    /** Like the first, into a pooled frame */
+    KittiPointFrame::Ptr getTrackletPointFrame(const KittiPointFrame& pointFrame, const KittiTracklet& tracklet, int frameId,
+                                               KittiBoxKernel::OutputFrame outputFrame, const Eigen::Vector3f& offset,
+                                               std::vector<int>* indices = NULL);
+    /** Like the second, into a pooled frame */
+    KittiPointFrame::Ptr getTrackletPointFrame(const KittiPointFrame& pointFrame, const std::vector<int>& indices,
+                                               const KittiTracklet& tracklet, int frameId,
+                                               KittiBoxKernel::OutputFrame outputFrame, const Eigen::Vector3f& offset);
     Tracklets& getTracklets();
+    KittiActiveTracklets getActiveTracklets(int frameId);
+    /** The Velodyne pose of every frame, read from the OXTS packets on first use */
+    const KittiPoseTable& getPoses();
+    /** The camera calibration of the recording date, NULL if it cannot be read */
+    KittiCameraCalibration::ConstPtr getCameraCalibration();
+
+    /** Number of buffers the pools of this data set had to create so far */
+    std::size_t getBufferAllocations() const;
 
     static int getLabel(const char* labelString);
     static void getColor(const char* labelString, int& r, int& g, int& b);
@@ -57,11 +176,35 @@ private:
 
     int _dataset;
     int _number_of_frames;
-    /** Counts the number of files with an ".bin" extension in the point cloud path */
+    KittiFrameIndex _frame_index;
+    KittiPathTemplate _point_cloud_path_template;
+    std::vector<KittiPathTemplate> _image_path_templates;
+
+    KittiBufferPool<KittiPointFrame> _point_frame_pool;
+    KittiBufferPool<KittiPointFrame> _tracklet_frame_pool;
+    KittiBufferPool<KittiPointCloud> _point_cloud_pool;
+    /** Reads or builds the index of the point cloud files, see KittiFrameIndex */
     void initNumberOfFrames();
+    KittiSequenceArchive _sequence_archive;
+    bool initSequenceArchive();
+    /** Shared by all readers of the archive, NULL while frames are decoded on the loading thread */
+    boost::shared_ptr<KittiThreadPool> _decode_pool;
 
     Tracklets _tracklets;
     void initTracklets();
+    void initTrackletGrid(const KittiActiveTracklets& tracklets, int frameId, KittiBoxGrid& grid);
+
+    /**
+     * Ids of the active tracklets of frame f are stored in
+     * _active_tracklet_ids[_active_tracklet_offsets[f] .. _active_tracklet_offsets[f + 1]]
+     */
+    std::vector<int> _active_tracklet_offsets;
+    std::vector<int> _active_tracklet_ids;
+    void initActiveTracklets();
+
+    std::once_flag _poses_loaded;
+    KittiPoseTable _poses;
+    void initPoses();
 };
 
 #endif // KITTIDATASET_H
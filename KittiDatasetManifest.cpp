@@ -0,0 +1,384 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "KittiDatasetManifest.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include "KittiConfig.h"
+#include "KittiSequenceArchive.h"
+#include "KittiThreadPool.h"
+
+const int KittiDatasetManifest::version = 2;
+const int KittiDatasetInfo::dateIdStride;
+
+namespace
+{
+
+const std::string driveSuffix = "_sync";
+
+/** Returns the drive number of a folder named like "2011_09_26_drive_0001_sync" or "0001_sync", or -1 */
+int getDriveNumber(const std::string& folderName)
+{
+    if (folderName.size() <= driveSuffix.size()
+            || folderName.compare(folderName.size() - driveSuffix.size(), driveSuffix.size(), driveSuffix) != 0)
+    {
+        return -1;
+    }
+
+    std::size_t end = folderName.size() - driveSuffix.size();
+    std::size_t begin = end;
+    while (begin > 0 && std::isdigit((unsigned char) folderName[begin - 1]))
+    {
+        begin--;
+    }
+    if (begin == end)
+        return -1;
+    return std::atoi(folderName.substr(begin, end - begin).c_str());
+}
+
+/** Returns the date of a folder named like "2011_09_26_drive_0001_sync", or parentDate */
+std::string getDriveDate(const std::string& folderName, const std::string& parentDate)
+{
+    std::size_t end = folderName.find("_drive_");
+    if (end == std::string::npos || end == 0)
+        return parentDate;
+    return folderName.substr(0, end);
+}
+
+boost::int64_t getModificationTime(const boost::filesystem::path& directory)
+{
+    boost::system::error_code error;
+    boost::int64_t modificationTime = boost::filesystem::last_write_time(directory, error);
+    return error ? -1 : modificationTime;
+}
+
+/** Returns path relative to root if it is below it, otherwise path itself */
+std::string getRelativePath(const boost::filesystem::path& path, const boost::filesystem::path& root)
+{
+    std::string relative = path.generic_string();
+    std::string prefix = root.generic_string();
+    if (relative.compare(0, prefix.size(), prefix) == 0)
+    {
+        relative = relative.substr(prefix.size());
+        relative.erase(0, relative.find_first_not_of('/'));
+    }
+    return relative.empty() ? "." : relative;
+}
+
+int countFiles(const boost::filesystem::path& directory, const std::string& extension)
+{
+    int count = 0;
+    boost::system::error_code error;
+    boost::filesystem::directory_iterator dit(directory, error);
+    boost::filesystem::directory_iterator eit;
+    for (; !error && dit != eit; dit.increment(error))
+    {
+        if (dit->path().extension() == extension && boost::filesystem::is_regular_file(dit->status()))
+            count++;
+    }
+    return count;
+}
+
+bool isDirectory(const boost::filesystem::path& path)
+{
+    boost::system::error_code error;
+    return boost::filesystem::is_directory(path, error);
+}
+
+bool isRegularFile(const boost::filesystem::path& path)
+{
+    boost::system::error_code error;
+    return boost::filesystem::is_regular_file(path, error);
+}
+
+/** Checks which streams of the KITTI raw data layout a drive folder contains */
+KittiDatasetInfo inspectDrive(const boost::filesystem::path& directory, int number, const std::string& date)
+{
+    KittiDatasetInfo info;
+    info.id = number;
+    info.number = number;
+    info.date = date;
+    info.directory = directory;
+    info.numberOfFrames = 0;
+    info.streams = 0;
+
+    // The same folders KittiDataset reads, see KittiConfig
+    boost::filesystem::path pointCloudPath = KittiConfig::getPointCloudPath(directory);
+    boost::filesystem::path sequenceArchivePath = KittiConfig::getSequenceArchivePath(directory);
+    if (isDirectory(pointCloudPath))
+    {
+        info.streams |= KittiDatasetInfo::VELODYNE;
+        info.numberOfFrames = countFiles(pointCloudPath, KittiConfig::getPointCloudFileExtension());
+    }
+    else if (isRegularFile(sequenceArchivePath))
+    {
+        // Drives may be shipped with the sequence archive only
+        KittiSequenceArchive archive;
+        if (archive.open(sequenceArchivePath))
+        {
+            info.streams |= KittiDatasetInfo::VELODYNE;
+            info.numberOfFrames = archive.getNumberOfFrames();
+        }
+    }
+    const KittiDatasetInfo::Stream cameras[KittiConfig::numberOfCameras] = {
+        KittiDatasetInfo::IMAGE_00, KittiDatasetInfo::IMAGE_01,
+        KittiDatasetInfo::IMAGE_02, KittiDatasetInfo::IMAGE_03
+    };
+    for (int camera = 0; camera < KittiConfig::numberOfCameras; ++camera)
+    {
+        if (isDirectory(KittiConfig::getImagePath(directory, camera)))
+            info.streams |= cameras[camera];
+    }
+    if (isDirectory(KittiConfig::getOxtsPath(directory)))
+        info.streams |= KittiDatasetInfo::OXTS;
+    if (isRegularFile(KittiConfig::getTrackletsPath(directory)))
+        info.streams |= KittiDatasetInfo::TRACKLETS;
+    return info;
+}
+
+/** Appends the drives found directly in directory */
+void scanFolder(const boost::filesystem::path& directory, std::vector<KittiDatasetInfo>& datasets)
+{
+    boost::system::error_code error;
+    boost::filesystem::directory_iterator dit(directory, error);
+    boost::filesystem::directory_iterator eit;
+    for (; !error && dit != eit; dit.increment(error))
+    {
+        std::string folderName = dit->path().filename().string();
+        int number = getDriveNumber(folderName);
+        if (number >= 0 && isDirectory(dit->path()))
+            datasets.push_back(inspectDrive(dit->path(), number, getDriveDate(folderName, directory.filename().string())));
+    }
+}
+
+bool writeManifest(const boost::filesystem::path& path,
+                   const boost::filesystem::path& dataDirectory,
+                   const std::vector<KittiDatasetInfo>& datasets,
+                   const std::vector<KittiDatasetManifest::Folder>& folders)
+{
+    std::ofstream file(path.string().c_str());
+    if (!file.good())
+        return false;
+
+    file << "kitti-manifest " << KittiDatasetManifest::version << " "
+         << datasets.size() << " " << folders.size() << std::endl;
+    for (std::size_t i = 0; i < folders.size(); ++i)
+    {
+        file << folders[i].modificationTime << " "
+             << getRelativePath(folders[i].directory, dataDirectory) << std::endl;
+    }
+    for (std::size_t i = 0; i < datasets.size(); ++i)
+    {
+        // Store the drive folder relative to the data directory
+        file << datasets[i].number << " "
+             << datasets[i].numberOfFrames << " "
+             << datasets[i].streams << " "
+             << (datasets[i].date.empty() ? "-" : datasets[i].date) << " "
+             << getRelativePath(datasets[i].directory, dataDirectory) << std::endl;
+    }
+    return file.good();
+}
+
+bool compareDatasets(const KittiDatasetInfo& a, const KittiDatasetInfo& b)
+{
+    if (a.date != b.date)
+        return a.date < b.date;
+    if (a.number != b.number)
+        return a.number < b.number;
+    return a.directory < b.directory;
+}
+
+}
+
+std::vector<KittiDatasetInfo> KittiDatasetManifest::scan(const boost::filesystem::path& dataDirectory,
+                                                         std::vector<Folder>* scannedFolders)
+{
+    // Drives directly in the data directory, and the folders that may contain more of them
+    std::vector<KittiDatasetInfo> datasets;
+    std::vector<boost::filesystem::path> folders;
+    boost::system::error_code error;
+    boost::filesystem::directory_iterator dit(dataDirectory, error);
+    boost::filesystem::directory_iterator eit;
+    for (; !error && dit != eit; dit.increment(error))
+    {
+        if (!isDirectory(dit->path()))
+            continue;
+        std::string folderName = dit->path().filename().string();
+        int number = getDriveNumber(folderName);
+        if (number >= 0)
+            datasets.push_back(inspectDrive(dit->path(), number, getDriveDate(folderName, "")));
+        else
+            folders.push_back(dit->path());
+    }
+
+    // Network mounts are mostly latency bound, so scan the date folders in parallel
+    std::vector<std::vector<KittiDatasetInfo> > found(folders.size());
+    if (!folders.empty())
+    {
+        KittiThreadPool pool((int) std::min(std::thread::hardware_concurrency() * 2, (unsigned int) folders.size()));
+        pool.run(folders.size(), [&](std::size_t i) { scanFolder(folders[i], found[i]); });
+    }
+    for (std::size_t i = 0; i < found.size(); ++i)
+    {
+        datasets.insert(datasets.end(), found[i].begin(), found[i].end());
+    }
+
+    std::sort(datasets.begin(), datasets.end(), compareDatasets);
+
+    // Adding or removing a drive changes the modification time of its parent
+    if (scannedFolders)
+    {
+        scannedFolders->clear();
+        folders.insert(folders.begin(), dataDirectory);
+        for (std::size_t i = 0; i < folders.size(); ++i)
+        {
+            Folder folder;
+            folder.directory = folders[i];
+            folder.modificationTime = getModificationTime(folders[i]);
+            scannedFolders->push_back(folder);
+        }
+    }
+    return datasets;
+}
+
+bool KittiDatasetManifest::load(const boost::filesystem::path& manifestPath,
+                                const boost::filesystem::path& dataDirectory,
+                                std::vector<KittiDatasetInfo>& datasets)
+{
+    std::ifstream file(manifestPath.string().c_str());
+    if (!file.good())
+        return false;
+
+    std::string line;
+    int fileVersion = 0;
+    int numberOfDatasets = 0;
+    int numberOfFolders = 0;
+    if (!std::getline(file, line)
+            || std::sscanf(line.c_str(), "kitti-manifest %d %d %d", &fileVersion, &numberOfDatasets, &numberOfFolders) != 3
+            || fileVersion != version)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < numberOfFolders; ++i)
+    {
+        std::string directory;
+        boost::int64_t modificationTime = 0;
+        if (!std::getline(file, line))
+        {
+            std::cerr << "Error in KittiDatasetManifest: " << manifestPath.string() << " is truncated" << std::endl;
+            return false;
+        }
+        std::istringstream fields(line);
+        fields >> modificationTime >> std::ws;
+        std::getline(fields, directory);
+        if (fields.fail() || directory.empty())
+        {
+            std::cerr << "Error in KittiDatasetManifest: Invalid line in "
+                      << manifestPath.string() << ": " << line << std::endl;
+            return false;
+        }
+        if (getModificationTime(dataDirectory / directory) != modificationTime)
+        {
+            std::cout << (dataDirectory / directory).string() << " changed since the data set manifest was written" << std::endl;
+            return false;
+        }
+    }
+
+    std::vector<KittiDatasetInfo> loaded;
+    for (int i = 0; i < numberOfDatasets; ++i)
+    {
+        if (!std::getline(file, line))
+        {
+            std::cerr << "Error in KittiDatasetManifest: " << manifestPath.string() << " is truncated" << std::endl;
+            return false;
+        }
+
+        std::istringstream fields(line);
+        KittiDatasetInfo info;
+        std::string date;
+        std::string directory;
+        fields >> info.number >> info.numberOfFrames >> info.streams >> date >> std::ws;
+        std::getline(fields, directory);
+        if (fields.fail() || directory.empty())
+        {
+            std::cerr << "Error in KittiDatasetManifest: Invalid line in "
+                      << manifestPath.string() << ": " << line << std::endl;
+            return false;
+        }
+        info.id = info.number;
+        info.date = date == "-" ? std::string() : date;
+        info.directory = dataDirectory / directory;
+        loaded.push_back(info);
+    }
+
+    datasets.swap(loaded);
+    return true;
+}
+
+bool KittiDatasetManifest::save(const boost::filesystem::path& manifestPath,
+                                const boost::filesystem::path& dataDirectory,
+                                const std::vector<KittiDatasetInfo>& datasets,
+                                const std::vector<Folder>& folders)
+{
+    // Write to a temporary file first, so an interrupted write leaves no
+    // truncated manifest behind
+    boost::filesystem::path temporaryPath = manifestPath;
+    temporaryPath += ".tmp";
+    boost::system::error_code error;
+    if (!writeManifest(temporaryPath, dataDirectory, datasets, folders))
+    {
+        boost::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+    boost::filesystem::rename(temporaryPath, manifestPath, error);
+    if (error)
+    {
+        boost::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+
+    // Renaming the manifest into its folder changed the modification time
+    // of that folder; record the new one. Rewriting the file in place does
+    // not change it again.
+    std::vector<Folder> updatedFolders(folders);
+    bool changed = false;
+    for (std::size_t i = 0; i < updatedFolders.size(); ++i)
+    {
+        if (boost::filesystem::equivalent(updatedFolders[i].directory, manifestPath.parent_path(), error))
+        {
+            boost::int64_t modificationTime = getModificationTime(updatedFolders[i].directory);
+            changed = changed || modificationTime != updatedFolders[i].modificationTime;
+            updatedFolders[i].modificationTime = modificationTime;
+        }
+    }
+    return !changed || writeManifest(manifestPath, dataDirectory, datasets, updatedFolders);
+}
@@ -0,0 +1,118 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef KITTIDATASETMANIFEST_H
+#define KITTIDATASETMANIFEST_H
+
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/filesystem/path.hpp>
+
+/**
+ * @brief A data set (drive) found below the data directory
+ */
+struct KittiDatasetInfo
+{
+    /** Streams recorded for a drive, combined as a bit mask */
+    enum Stream
+    {
+        VELODYNE  = 1 << 0,
+        IMAGE_00  = 1 << 1,
+        IMAGE_01  = 1 << 2,
+        IMAGE_02  = 1 << 3,
+        IMAGE_03  = 1 << 4,
+        OXTS      = 1 << 5,
+        TRACKLETS = 1 << 6
+    };
+
+    /**
+     * Identifies the drive within the data directory, see
+     * KittiConfig::initAvailableDatasets(). Drive numbers repeat across
+     * recording dates, so this is the drive number for the drives of the
+     * first date and the drive number plus datesBefore * dateIdStride
+     * otherwise.
+     */
+    int id;
+    /** The drive number, e.g. 1 for 2011_09_26_drive_0001_sync */
+    int number;
+    /** The recording date, e.g. "2011_09_26", empty if the folders do not tell */
+    std::string date;
+    /** The *_sync folder of the drive */
+    boost::filesystem::path directory;
+    int numberOfFrames;
+    unsigned int streams;
+
+    bool hasStream(Stream stream) const { return (streams & stream) != 0; }
+
+    /** Id distance between the drives of consecutive recording dates */
+    static const int dateIdStride = 10000;
+};
+
+/**
+ * @brief The KittiDatasetManifest class
+ *
+ * Finds the drives below a data directory and remembers them in a manifest
+ * file, so that later starts do not have to walk the directory tree again.
+ *
+ * A drive is any folder whose name ends with "_sync" and which is either
+ * directly in the data directory or in one of its subfolders, e.g.
+ *
+ *   /data/2011_09_26/2011_09_26_drive_0001_sync
+ *   /data/2011_09_26/0001_sync
+ *
+ * The drive number is taken from the digits in front of "_sync", the date
+ * from the text in front of "_drive_" or else from the name of the
+ * subfolder. The date folders are scanned in parallel.
+ *
+ * The manifest is a text file with a header holding the number of drives
+ * and folders, the modification time of every folder that was scanned, and
+ * one line per drive: number, number of frames, stream mask, date and the
+ * drive folder relative to the data directory. load() rejects a manifest
+ * whose folders changed since the scan, so adding or removing a drive
+ * triggers a new scan.
+ */
+class KittiDatasetManifest
+{
+
+public:
+
+    /** A folder that was searched for drives */
+    struct Folder
+    {
+        boost::filesystem::path directory;
+        boost::int64_t modificationTime;
+    };
+
+    /** Also returns the searched folders in folders, if not NULL */
+    static std::vector<KittiDatasetInfo> scan(const boost::filesystem::path& dataDirectory,
+                                              std::vector<Folder>* folders = NULL);
+    /** Fails if the file is incomplete or one of the searched folders changed */
+    static bool load(const boost::filesystem::path& manifestPath,
+                     const boost::filesystem::path& dataDirectory,
+                     std::vector<KittiDatasetInfo>& datasets);
+    static bool save(const boost::filesystem::path& manifestPath,
+                     const boost::filesystem::path& dataDirectory,
+                     const std::vector<KittiDatasetInfo>& datasets,
+                     const std::vector<Folder>& folders);
+
+    static const int version;
+};
+
+#endif // KITTIDATASETMANIFEST_H
@@ -0,0 +1,253 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "KittiFrameIndex.h"
+
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+const unsigned int KittiFrameIndex::version = 1;
+
+namespace
+{
+
+const char magic[8] = { 'K', 'F', 'R', 'M', 'I', 'N', 'D', 'X' };
+
+/** Stray files with huge numbers must not blow up the index */
+const int maximumFrameId = 1 << 24;
+
+struct Header
+{
+    char magic[8];
+    boost::uint32_t version;
+    boost::uint32_t reserved;
+    boost::int64_t directoryModificationTime;
+    boost::uint32_t numberOfFrames;
+    boost::uint32_t directoryLength;
+};
+
+/** Returns the frame number of a scan file name like 0000000042.bin, or -1 */
+int getFrameId(const boost::filesystem::path& path)
+{
+    if (path.extension() != ".bin")
+        return -1;
+    std::string stem = path.stem().string();
+    if (stem.empty())
+        return -1;
+    int frameId = 0;
+    for (std::size_t i = 0; i < stem.size(); ++i)
+    {
+        if (!std::isdigit((unsigned char) stem[i]))
+            return -1;
+        frameId = 10 * frameId + (stem[i] - '0');
+        if (frameId > maximumFrameId)
+            return -1;
+    }
+    return frameId;
+}
+
+}
+
+KittiFrameIndex::KittiFrameIndex() :
+    _directory_modification_time(0)
+{
+}
+
+bool KittiFrameIndex::init(const boost::filesystem::path& directory,
+                           const std::vector<boost::filesystem::path>& cachePaths)
+{
+    for (std::size_t i = 0; i < cachePaths.size(); ++i)
+    {
+        if (load(cachePaths[i], directory))
+            return true;
+    }
+
+    if (!build(directory))
+        return false;
+    for (std::size_t i = 0; i < cachePaths.size(); ++i)
+    {
+        if (save(cachePaths[i]))
+            return true;
+    }
+    std::cerr << "Warning in KittiFrameIndex: Could not write the frame index of "
+              << directory.string() << std::endl;
+    return true;
+}
+
+bool KittiFrameIndex::build(const boost::filesystem::path& directory)
+{
+    _directory = directory;
+    _file_sizes.clear();
+    _missing_frames.clear();
+
+    boost::system::error_code error;
+    _directory_modification_time = boost::filesystem::last_write_time(directory, error);
+    if (error)
+        return false;
+
+    boost::filesystem::directory_iterator dit(directory, error);
+    boost::filesystem::directory_iterator eit;
+    if (error)
+        return false;
+
+    // This is the only place that stat()s the scans; frame loads take the
+    // file size from the index
+    for (; dit != eit; dit.increment(error))
+    {
+        if (error)
+            return false;
+        int frameId = getFrameId(dit->path());
+        if (frameId < 0 || !boost::filesystem::is_regular_file(dit->status()))
+            continue;
+        boost::uintmax_t size = boost::filesystem::file_size(dit->path(), error);
+        if (error)
+            continue;
+        if (frameId >= (int) _file_sizes.size())
+            _file_sizes.resize(frameId + 1, 0);
+        _file_sizes[frameId] = size;
+    }
+
+    initMissingFrames();
+    return true;
+}
+
+bool KittiFrameIndex::load(const boost::filesystem::path& cachePath, const boost::filesystem::path& directory)
+{
+    boost::system::error_code error;
+    boost::int64_t directoryModificationTime = boost::filesystem::last_write_time(directory, error);
+    if (error || !boost::filesystem::exists(cachePath, error))
+        return false;
+
+    boost::iostreams::mapped_file_source file;
+    try
+    {
+        file.open(cachePath.string());
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+
+    Header header;
+    if (file.size() < sizeof(header))
+        return false;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0
+            || header.version != version
+            || header.directoryModificationTime != directoryModificationTime
+            || file.size() != sizeof(header) + header.directoryLength
+                              + header.numberOfFrames * sizeof(boost::uint64_t))
+    {
+        return false;
+    }
+
+    // Indexes in the user cache directory are shared by all drives, so make
+    // sure this one describes the requested directory
+    const char* data = file.data() + sizeof(header);
+    if (std::string(data, header.directoryLength) != directory.generic_string())
+        return false;
+    data += header.directoryLength;
+
+    _directory = directory;
+    _directory_modification_time = directoryModificationTime;
+    _file_sizes.resize(header.numberOfFrames);
+    if (header.numberOfFrames)
+        std::memcpy(&_file_sizes[0], data, header.numberOfFrames * sizeof(boost::uint64_t));
+    initMissingFrames();
+    return true;
+}
+
+bool KittiFrameIndex::save(const boost::filesystem::path& cachePath) const
+{
+    std::string directory = _directory.generic_string();
+
+    Header header;
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.reserved = 0;
+    header.directoryModificationTime = _directory_modification_time;
+    header.numberOfFrames = _file_sizes.size();
+    header.directoryLength = directory.size();
+
+    boost::system::error_code error;
+    boost::filesystem::create_directories(cachePath.parent_path(), error);
+
+    // Write to a temporary file first so a concurrent reader never maps a
+    // partially written index
+    boost::filesystem::path temporaryPath = cachePath;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream file(temporaryPath.string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file.good())
+            return false;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(directory.data(), directory.size());
+        if (!_file_sizes.empty())
+            file.write(reinterpret_cast<const char*>(&_file_sizes[0]), _file_sizes.size() * sizeof(boost::uint64_t));
+        if (!file.good())
+            return false;
+    }
+
+    boost::filesystem::rename(temporaryPath, cachePath, error);
+    if (error)
+    {
+        boost::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+    return true;
+}
+
+int KittiFrameIndex::getNumberOfFrames() const
+{
+    return _file_sizes.size();
+}
+
+bool KittiFrameIndex::hasFrame(int frameId) const
+{
+    return getFileSize(frameId) > 0;
+}
+
+boost::uint64_t KittiFrameIndex::getFileSize(int frameId) const
+{
+    if (frameId < 0 || frameId >= (int) _file_sizes.size())
+        return 0;
+    return _file_sizes[frameId];
+}
+
+const std::vector<int>& KittiFrameIndex::getMissingFrames() const
+{
+    return _missing_frames;
+}
+
+void KittiFrameIndex::initMissingFrames()
+{
+    _missing_frames.clear();
+    for (std::size_t i = 0; i < _file_sizes.size(); ++i)
+    {
+        if (_file_sizes[i] == 0)
+            _missing_frames.push_back(i);
+    }
+}
@@ -0,0 +1,84 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef KITTIFRAMEINDEX_H
+#define KITTIFRAMEINDEX_H
+
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/filesystem/path.hpp>
+
+/**
+ * @brief The KittiFrameIndex class
+ *
+ * Lists the point cloud files of a drive by frame number. Listing a
+ * directory with thousands of scans is slow on network storage, so the index
+ * is kept in a small binary file, either next to the data or, if that folder
+ * is read-only, in the user cache directory. An index is only used while the
+ * modification time of the listed directory is unchanged; adding, removing
+ * or renaming scans updates that time.
+ *
+ * Frame numbers without a file are gaps. They count towards the number of
+ * frames but have a file size of 0.
+ *
+ * File layout (native byte order):
+ *
+ *   Header         magic, version, directory mtime, number of frames,
+ *                  length of the directory path
+ *   char[]         the listed directory
+ *   uint64[]       file size per frame
+ */
+class KittiFrameIndex
+{
+
+public:
+
+    KittiFrameIndex();
+
+    /**
+     * Loads the first valid index among cachePaths, or lists the directory
+     * and writes the index to the first of cachePaths that is writable.
+     */
+    bool init(const boost::filesystem::path& directory,
+              const std::vector<boost::filesystem::path>& cachePaths);
+
+    /** Lists the directory, ignoring any cached index */
+    bool build(const boost::filesystem::path& directory);
+    bool load(const boost::filesystem::path& cachePath, const boost::filesystem::path& directory);
+    bool save(const boost::filesystem::path& cachePath) const;
+
+    /** The highest frame number plus one, including gaps */
+    int getNumberOfFrames() const;
+    bool hasFrame(int frameId) const;
+    boost::uint64_t getFileSize(int frameId) const;
+    const std::vector<int>& getMissingFrames() const;
+
+    static const unsigned int version;
+
+private:
+
+    boost::filesystem::path _directory;
+    boost::int64_t _directory_modification_time;
+    std::vector<boost::uint64_t> _file_sizes;
+    std::vector<int> _missing_frames;
+
+    void initMissingFrames();
+};
+
+#endif // KITTIFRAMEINDEX_H
@@ -0,0 +1,231 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "KittiFramePrefetcher.h"
+
+#include <vector>
+
+#include <QMutexLocker>
+
+KittiFramePrefetcher::KittiFramePrefetcher(int radius, const Eigen::Vector3f& trackletOffset, float voxelLeafSize) :
+    _radius(radius < 0 ? 0 : radius),
+    _tracklet_offset(trackletOffset),
+    _voxel_grid(voxelLeafSize),
+    _reduced_frame_pool(2 * _radius + 4),
+    _frames(2 * _radius + 1),
+    _dataset(NULL),
+    _center(0),
+    _requested(false),
+    _loading(false),
+    _worker_frame_id(-1),
+    _caller_frame_id(-1),
+    _abort(false)
+{
+    start(QThread::LowPriority);
+}
+
+KittiFramePrefetcher::~KittiFramePrefetcher()
+{
+    {
+        QMutexLocker locker(&_mutex);
+        _abort = true;
+        _wakeup.wakeOne();
+    }
+    wait();
+}
+
+void KittiFramePrefetcher::setDataset(KittiDataset* dataset)
+{
+    QMutexLocker locker(&_mutex);
+    while (_loading)
+    {
+        _idle.wait(&_mutex);
+    }
+    _dataset = dataset;
+    _requested = false;
+    for (std::size_t i = 0; i < _frames.size(); ++i)
+    {
+        _frames[i].reset();
+    }
+}
+
+KittiFrame::Ptr KittiFramePrefetcher::getFrame(int frameId)
+{
+    KittiDataset* dataset;
+    {
+        QMutexLocker locker(&_mutex);
+        KittiFrame::Ptr frame = findFrame(frameId);
+        // Reading the frame a second time would take as long as waiting
+        while (!frame && _loading && _worker_frame_id == frameId)
+        {
+            _idle.wait(&_mutex);
+            frame = findFrame(frameId);
+        }
+        if (frame)
+        {
+            return frame;
+        }
+        dataset = _dataset;
+        _caller_frame_id = frameId;
+    }
+
+    // Cache miss, e.g. when jumping with the slider: load on the calling thread
+    KittiFrame::Ptr frame = loadFrame(*dataset, frameId, _tracklet_offset);
+
+    QMutexLocker locker(&_mutex);
+    _caller_frame_id = -1;
+    if (dataset == _dataset)
+    {
+        storeFrame(frame);
+    }
+    return frame;
+}
+
+KittiFrame::Ptr KittiFramePrefetcher::getResidentFrame(int frameId)
+{
+    QMutexLocker locker(&_mutex);
+    return findFrame(frameId);
+}
+
+void KittiFramePrefetcher::prefetch(int frameId)
+{
+    QMutexLocker locker(&_mutex);
+    _center = frameId;
+    _requested = true;
+    _wakeup.wakeOne();
+}
+
+KittiFrame::Ptr KittiFramePrefetcher::loadFrame(KittiDataset& dataset, int frameId, const Eigen::Vector3f& trackletOffset)
+{
+    KittiFrame::Ptr frame(new KittiFrame);
+    frame->dataset = dataset.getDatasetNumber();
+    frame->frameId = frameId;
+    frame->pointFrame = dataset.getPointFrame(frameId);
+
+    // Find the points of all tracklets in one batch, then copy only those
+    KittiActiveTracklets tracklets = dataset.getActiveTracklets(frameId);
+    boost::shared_ptr<std::vector<std::vector<int> > > trackletPointIndices(new std::vector<std::vector<int> >);
+    dataset.getTrackletPointIndices(*frame->pointFrame, frameId, *trackletPointIndices);
+    boost::shared_ptr<std::vector<KittiPointFrame::Ptr> > trackletPointFrames(
+                new std::vector<KittiPointFrame::Ptr>(tracklets.size()));
+    for (int i = 0; i < tracklets.size(); ++i)
+    {
+        (*trackletPointFrames)[i] = dataset.getTrackletPointFrame(*frame->pointFrame, (*trackletPointIndices)[i],
+                                                                  tracklets.at(i), frameId,
+                                                                  KittiBoxKernel::POINT_FRAME, trackletOffset);
+    }
+    frame->trackletPointIndices = trackletPointIndices;
+    frame->trackletPointFrames = trackletPointFrames;
+    return frame;
+}
+
+void KittiFramePrefetcher::run()
+{
+    QMutexLocker locker(&_mutex);
+    while (!_abort)
+    {
+        int frameId;
+        if (!_requested || !_dataset || !nextMissingFrame(frameId))
+        {
+            _requested = false;
+            _wakeup.wait(&_mutex);
+            continue;
+        }
+
+        KittiDataset* dataset = _dataset;
+        KittiFrame::Ptr frame = findFrame(frameId);
+        _loading = true;
+        _worker_frame_id = frameId;
+        locker.unlock();
+
+        if (!frame)
+        {
+            frame = loadFrame(*dataset, frameId, _tracklet_offset);
+        }
+        if (!isComplete(frame))
+        {
+            frame = reduceFrame(*frame);
+        }
+
+        locker.relock();
+        if (dataset == _dataset)
+        {
+            storeFrame(frame);
+        }
+        _loading = false;
+        _worker_frame_id = -1;
+        _idle.wakeAll();
+    }
+}
+
+KittiFrame::Ptr KittiFramePrefetcher::findFrame(int frameId)
+{
+    if (!_dataset || frameId < 0)
+    {
+        return KittiFrame::Ptr();
+    }
+    const KittiFrame::Ptr& frame = _frames.at(frameId % _frames.size());
+    if (frame && frame->frameId == frameId && frame->dataset == _dataset->getDatasetNumber())
+    {
+        return frame;
+    }
+    return KittiFrame::Ptr();
+}
+
+void KittiFramePrefetcher::storeFrame(const KittiFrame::Ptr& frame)
+{
+    _frames.at(frame->frameId % _frames.size()) = frame;
+}
+
+bool KittiFramePrefetcher::isComplete(const KittiFrame::Ptr& frame) const
+{
+    return frame && (frame->reducedPointFrame || _voxel_grid.getLeafSize() <= 0.0f);
+}
+
+bool KittiFramePrefetcher::nextMissingFrame(int& frameId)
+{
+    // The window [center - radius, center + radius] maps onto distinct slots,
+    // so loading a frame of the window never evicts another one of it.
+    // Frames ahead are preferred since playback usually moves forward.
+    int number_of_frames = _dataset->getNumberOfFrames();
+    for (int distance = 0; distance <= _radius; ++distance)
+    {
+        int candidates[2] = { _center + distance, _center - distance };
+        for (int i = 0; i < 2; ++i)
+        {
+            // A frame getFrame() is loading is reduced once it is stored
+            if (candidates[i] >= 0 && candidates[i] < number_of_frames && candidates[i] != _caller_frame_id
+                    && !isComplete(findFrame(candidates[i])))
+            {
+                frameId = candidates[i];
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+KittiFrame::Ptr KittiFramePrefetcher::reduceFrame(const KittiFrame& frame)
+{
+    // The viewer may be showing the frame, so the reduced points go into a
+    // copy. It shares the points and tracklet data of the frame.
+    KittiFrame::Ptr reducedFrame(new KittiFrame(frame));
+    reducedFrame->reducedPointFrame = _reduced_frame_pool.acquire();
+    _voxel_grid.filter(*frame.pointFrame, *reducedFrame->reducedPointFrame);
+    return reducedFrame;
+}
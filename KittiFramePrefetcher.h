@@ -0,0 +1,125 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef KITTIFRAMEPREFETCHER_H
+#define KITTIFRAMEPREFETCHER_H
+
+#include <vector>
+
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <boost/shared_ptr.hpp>
+
+#include <eigen3/Eigen/Core>
+
+#include "KittiBufferPool.h"
+#include "KittiDataset.h"
+#include "KittiVoxelGrid.h"
+
+/**
+ * @brief Everything the viewer needs to display one frame of a data set
+ */
+struct KittiFrame
+{
+    typedef boost::shared_ptr<KittiFrame> Ptr;
+
+    int dataset;
+    int frameId;
+    KittiPointFrame::Ptr pointFrame;
+    /**
+     * Indices of the points inside the box of each active tracklet, see
+     * KittiDataset::getTrackletPointIndices(). Shared with the reduced copy
+     * of the frame, like the tracklet points below.
+     */
+    boost::shared_ptr<const std::vector<std::vector<int> > > trackletPointIndices;
+    /** Copies of those points, moved by the tracklet offset of the prefetcher */
+    boost::shared_ptr<const std::vector<KittiPointFrame::Ptr> > trackletPointFrames;
+    /** The points reduced by the voxel grid of the prefetcher, empty until the worker made it */
+    KittiPointFrame::Ptr reducedPointFrame;
+};
+
+/**
+ * @brief The KittiFramePrefetcher class
+ *
+ * Loads the frames surrounding the current one on a worker thread and keeps
+ * them in a ring buffer of 2 * radius + 1 slots keyed by data set and frame.
+ * Frames that are not resident yet are loaded synchronously by getFrame(),
+ * unless the worker is already loading them; then getFrame() waits for it.
+ *
+ * The points of every tracklet are cropped and moved by trackletOffset in
+ * the same pass, so the viewer can show them without further processing.
+ *
+ * If voxelLeafSize is positive, the worker also reduces every frame of the
+ * window with a KittiVoxelGrid of that leaf size. Frames loaded by getFrame()
+ * on the calling thread get their reduced points later from the worker, so
+ * the voxel grid never runs on the GUI thread.
+ */
+class KittiFramePrefetcher : public QThread
+{
+
+public:
+
+    KittiFramePrefetcher(int radius, const Eigen::Vector3f& trackletOffset, float voxelLeafSize = 0.0f);
+    virtual ~KittiFramePrefetcher();
+
+    /** Drops all cached frames. Waits until the worker no longer uses the previous data set. */
+    void setDataset(KittiDataset* dataset);
+    KittiFrame::Ptr getFrame(int frameId);
+    /** The frame if it is in the ring buffer, otherwise NULL; never loads or waits for it */
+    KittiFrame::Ptr getResidentFrame(int frameId);
+    /** Asks the worker to load the frames around frameId */
+    void prefetch(int frameId);
+
+    static KittiFrame::Ptr loadFrame(KittiDataset& dataset, int frameId, const Eigen::Vector3f& trackletOffset);
+
+protected:
+
+    void run();
+
+private:
+
+    int _radius;
+    Eigen::Vector3f _tracklet_offset;
+    /** Only used by the worker */
+    KittiVoxelGrid _voxel_grid;
+    KittiBufferPool<KittiPointFrame> _reduced_frame_pool;
+    std::vector<KittiFrame::Ptr> _frames;
+
+    KittiDataset* _dataset;
+    int _center;
+    bool _requested;
+    bool _loading;
+    /** The frames being loaded by the worker and by getFrame(), -1 if none */
+    int _worker_frame_id;
+    int _caller_frame_id;
+    bool _abort;
+
+    QMutex _mutex;
+    QWaitCondition _wakeup;
+    QWaitCondition _idle;
+
+    KittiFrame::Ptr findFrame(int frameId);
+    void storeFrame(const KittiFrame::Ptr& frame);
+    bool isComplete(const KittiFrame::Ptr& frame) const;
+    bool nextMissingFrame(int& frameId);
+    KittiFrame::Ptr reduceFrame(const KittiFrame& frame);
+};
+
+#endif // KITTIFRAMEPREFETCHER_H
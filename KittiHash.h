@@ -0,0 +1,44 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef KITTIHASH_H
+#define KITTIHASH_H
+
+#include <cstddef>
+#include <string>
+
+#include <boost/cstdint.hpp>
+
+/** 64 bit FNV-1a hash, for checksums and cache file names */
+inline boost::uint64_t kittiHash(const char* data, std::size_t size)
+{
+    boost::uint64_t hash = 14695981039346656037ULL;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        hash ^= (unsigned char) data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+inline boost::uint64_t kittiHash(const std::string& text)
+{
+    return kittiHash(text.data(), text.size());
+}
+
+#endif // KITTIHASH_H
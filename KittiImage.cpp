@@ -0,0 +1,78 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "KittiImage.h"
+
+#include <string>
+
+#include <QPainter>
+#include <QPaintEvent>
+
+KittiImage::KittiImage(QWidget* parent) :
+    QWidget(parent)
+{
+}
+
+void KittiImage::setPixmapFile(const std::string& fileName)
+{
+    setImage(QImage(QString::fromStdString(fileName)));
+}
+
+void KittiImage::setImage(const QImage& image)
+{
+    if (image.isNull())
+    {
+        pixmap = QPixmap();
+    }
+    else
+    {
+        pixmap = QPixmap::fromImage(image);
+    }
+    update();
+}
+
+void KittiImage::swapOverlay(QImage& overlay)
+{
+    this->overlay.swap(overlay);
+    update();
+}
+
+void KittiImage::paintEvent(QPaintEvent* event)
+{
+    QPainter painter(this);
+    painter.fillRect(event->rect(), Qt::black);
+    if (pixmap.isNull() && overlay.isNull())
+    {
+        return;
+    }
+
+    QSize scaledSize = pixmap.isNull() ? overlay.size() : pixmap.size();
+    scaledSize.scale(size(), Qt::KeepAspectRatio);
+    QRect target(QPoint((width() - scaledSize.width()) / 2,
+                        (height() - scaledSize.height()) / 2),
+                 scaledSize);
+    if (!pixmap.isNull())
+    {
+        painter.drawPixmap(target, pixmap);
+    }
+    if (!overlay.isNull())
+    {
+        // The overlay covers the image even if the rectified size differs by a pixel
+        painter.drawImage(target, overlay);
+    }
+}
@@ -0,0 +1,64 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef KITTIIMAGE_H
+#define KITTIIMAGE_H
+
+#include <string>
+
+#include <QImage>
+#include <QPixmap>
+#include <QWidget>
+
+/**
+ * @brief The KittiImage class
+ *
+ * Displays a camera image of the current frame, scaled to the widget while
+ * keeping its aspect ratio. An overlay in image coordinates, e.g. projected
+ * points, can be drawn on top of it.
+ */
+class KittiImage : public QWidget
+{
+    Q_OBJECT
+
+public:
+
+    KittiImage(QWidget* parent = 0);
+
+    /** Decodes and shows the image file. Blocks until decoding is done. */
+    void setPixmapFile(const std::string& fileName);
+    /** Shows an image that has already been decoded, e.g. by a worker thread */
+    void setImage(const QImage& image);
+    /**
+     * Shows overlay, a transparent image in the pixel coordinates of the
+     * camera image, on top of it. Takes the image data from overlay and
+     * hands back the previous overlay, so its buffer can be reused.
+     */
+    void swapOverlay(QImage& overlay);
+
+protected:
+
+    void paintEvent(QPaintEvent* event);
+
+private:
+
+    QPixmap pixmap;
+    QImage overlay;
+};
+
+#endif // KITTIIMAGE_H
@@ -0,0 +1,137 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "KittiImageCache.h"
+
+#include <algorithm>
+#include <string>
+
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QString>
+#include <QThread>
+
+class KittiImageCache::DecodeTask : public QRunnable
+{
+
+public:
+
+    DecodeTask(KittiImageCache* cache, const KittiImageKey& key, const std::string& fileName) :
+        _cache(cache), _key(key), _fileName(fileName) {}
+
+    void run()
+    {
+        if (!_cache->startDecoding(_key))
+            return;
+
+        // Convert here so that turning the image into a pixmap on the GUI
+        // thread is a plain copy
+        QImage image(QString::fromStdString(_fileName));
+        if (!image.isNull())
+            image = image.convertToFormat(QImage::Format_RGB32);
+        _cache->insert(_key, image);
+    }
+
+private:
+
+    KittiImageCache* _cache;
+    KittiImageKey _key;
+    std::string _fileName;
+};
+
+KittiImageCache::KittiImageCache(int capacity, QObject* parent) :
+    QObject(parent),
+    _capacity(std::max(capacity, 1)),
+    _windowDataset(-1),
+    _windowFirstFrame(0),
+    _windowLastFrame(-1)
+{
+    // Up to one decoder per camera, leaving cores to the point cloud prefetcher
+    _pool.setMaxThreadCount(std::max(1, std::min(QThread::idealThreadCount() / 2, 4)));
+}
+
+KittiImageCache::~KittiImageCache()
+{
+    {
+        QMutexLocker locker(&_mutex);
+        _windowDataset = -1;
+    }
+    _pool.waitForDone();
+}
+
+bool KittiImageCache::getImage(const KittiImageKey& key, QImage& image)
+{
+    QMutexLocker locker(&_mutex);
+    std::map<KittiImageKey, Entries::iterator>::iterator it = _index.find(key);
+    if (it == _index.end())
+        return false;
+
+    Entries& entries = _entries[key.camera];
+    entries.splice(entries.begin(), entries, it->second);
+    image = it->second->second;
+    return true;
+}
+
+void KittiImageCache::requestImage(const KittiImageKey& key, const std::string& fileName)
+{
+    {
+        QMutexLocker locker(&_mutex);
+        if (_index.count(key) || _queued.count(key))
+            return;
+        _queued.insert(key);
+    }
+    _pool.start(new DecodeTask(this, key, fileName));
+}
+
+void KittiImageCache::setWindow(int dataset, int firstFrame, int lastFrame)
+{
+    QMutexLocker locker(&_mutex);
+    _windowDataset = dataset;
+    _windowFirstFrame = firstFrame;
+    _windowLastFrame = lastFrame;
+}
+
+bool KittiImageCache::startDecoding(const KittiImageKey& key)
+{
+    QMutexLocker locker(&_mutex);
+    if (key.dataset != _windowDataset
+            || key.frameId < _windowFirstFrame
+            || key.frameId > _windowLastFrame)
+    {
+        _queued.erase(key);
+        return false;
+    }
+    return true;
+}
+
+void KittiImageCache::insert(const KittiImageKey& key, const QImage& image)
+{
+    {
+        QMutexLocker locker(&_mutex);
+        _queued.erase(key);
+        Entries& entries = _entries[key.camera];
+        entries.push_front(std::make_pair(key, image));
+        _index[key] = entries.begin();
+        while ((int) entries.size() > _capacity)
+        {
+            _index.erase(entries.back().first);
+            entries.pop_back();
+        }
+    }
+    emit imageReady(key.dataset, key.camera, key.frameId);
+}
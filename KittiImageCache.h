@@ -0,0 +1,112 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef KITTIIMAGECACHE_H
+#define KITTIIMAGECACHE_H
+
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+#include <QThreadPool>
+
+/**
+ * @brief Identifies one camera image of a data set
+ */
+struct KittiImageKey
+{
+    int dataset;
+    int camera;
+    int frameId;
+
+    KittiImageKey(int dataset, int camera, int frameId) :
+        dataset(dataset), camera(camera), frameId(frameId) {}
+
+    bool operator<(const KittiImageKey& other) const
+    {
+        if (dataset != other.dataset)
+            return dataset < other.dataset;
+        if (camera != other.camera)
+            return camera < other.camera;
+        return frameId < other.frameId;
+    }
+};
+
+/**
+ * @brief The KittiImageCache class
+ *
+ * Decodes camera images on a pool of worker threads and keeps the most
+ * recently used ones in memory. imageReady() is emitted, from a worker
+ * thread, whenever a requested image has been decoded.
+ *
+ * Every camera has its own list of recent images with room for capacity
+ * images, so showing more cameras does not evict the frames prefetched for
+ * the others. The images of one frame are decoded in parallel.
+ */
+class KittiImageCache : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    /** capacity is the number of images kept per camera */
+    KittiImageCache(int capacity, QObject* parent = 0);
+    virtual ~KittiImageCache();
+
+    /** Returns false if the image has not been decoded yet */
+    bool getImage(const KittiImageKey& key, QImage& image);
+    /** Decodes the image in the background unless it is cached or already queued */
+    void requestImage(const KittiImageKey& key, const std::string& fileName);
+    /**
+     * Queued requests outside of [firstFrame, lastFrame] of the data set are
+     * dropped when a worker picks them up, so scrubbing through a data set
+     * does not leave a backlog of images nobody looks at anymore.
+     */
+    void setWindow(int dataset, int firstFrame, int lastFrame);
+
+signals:
+
+    void imageReady(int dataset, int camera, int frameId);
+
+private:
+
+    class DecodeTask;
+
+    int _capacity;
+    QThreadPool _pool;
+
+    QMutex _mutex;
+    typedef std::list<std::pair<KittiImageKey, QImage> > Entries;
+    /** Most recently used first, per camera */
+    std::map<int, Entries> _entries;
+    std::map<KittiImageKey, Entries::iterator> _index;
+    std::set<KittiImageKey> _queued;
+
+    int _windowDataset;
+    int _windowFirstFrame;
+    int _windowLastFrame;
+
+    bool startDecoding(const KittiImageKey& key);
+    void insert(const KittiImageKey& key, const QImage& image);
+};
+
+#endif // KITTIIMAGECACHE_H
@@ -0,0 +1,117 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "KittiPointFrame.h"
+
+#include <algorithm>
+
+#include <boost/cstdint.hpp>
+
+const std::size_t KittiPointFrame::alignment;
+
+namespace
+{
+
+const std::size_t alignmentBytes = KittiPointFrame::alignment * sizeof(float);
+
+}
+
+KittiPointFrame::KittiPointFrame() :
+    _size(0),
+    _stride(0)
+{
+    std::fill(_columns, _columns + 4, (float*) NULL);
+}
+
+void KittiPointFrame::resize(std::size_t size)
+{
+    if (size > _stride)
+    {
+        reserve(size);
+    }
+    else if (size < _size)
+    {
+        // Everything behind the last point stays zero
+        for (int i = 0; i < 4; ++i)
+        {
+            std::fill(_columns[i] + size, _columns[i] + _size, 0.0f);
+        }
+    }
+    _size = size;
+}
+
+void KittiPointFrame::reserve(std::size_t capacity)
+{
+    std::size_t stride = (capacity + alignment - 1) / alignment * alignment;
+    if (stride > _stride)
+    {
+        // One block for all four arrays, with room to move the first one
+        // onto an aligned address
+        std::vector<float> storage(4 * stride + alignment, 0.0f);
+        boost::uintptr_t address = reinterpret_cast<boost::uintptr_t>(&storage[0]);
+        std::size_t offset = ((alignmentBytes - address % alignmentBytes) % alignmentBytes) / sizeof(float);
+        for (int i = 0; i < 4; ++i)
+        {
+            float* column = &storage[offset + i * stride];
+            std::copy(_columns[i], _columns[i] + _size, column);
+            _columns[i] = column;
+        }
+        _storage.swap(storage);
+        _stride = stride;
+    }
+}
+
+void KittiPointFrame::toPointCloud(pcl::PointCloud<pcl::PointXYZI>& pointCloud) const
+{
+    pointCloud.resize(_size);
+    for (std::size_t i = 0; i < _size; ++i)
+    {
+        pcl::PointXYZI& point = pointCloud.points[i];
+        point.x = _columns[0][i];
+        point.y = _columns[1][i];
+        point.z = _columns[2][i];
+        point.intensity = _columns[3][i];
+    }
+}
+
+void KittiPointFrame::toPointCloud(const std::vector<int>& indices, pcl::PointCloud<pcl::PointXYZI>& pointCloud) const
+{
+    pointCloud.resize(indices.size());
+    for (std::size_t i = 0; i < indices.size(); ++i)
+    {
+        int index = indices[i];
+        pcl::PointXYZI& point = pointCloud.points[i];
+        point.x = _columns[0][index];
+        point.y = _columns[1][index];
+        point.z = _columns[2][index];
+        point.intensity = _columns[3][index];
+    }
+}
+
+void KittiPointFrame::fromPointCloud(const pcl::PointCloud<pcl::PointXYZI>& pointCloud)
+{
+    resize(pointCloud.size());
+    for (std::size_t i = 0; i < _size; ++i)
+    {
+        const pcl::PointXYZI& point = pointCloud.points[i];
+        _columns[0][i] = point.x;
+        _columns[1][i] = point.y;
+        _columns[2][i] = point.z;
+        _columns[3][i] = point.intensity;
+    }
+}
@@ -0,0 +1,101 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef KITTIPOINTFRAME_H
+#define KITTIPOINTFRAME_H
+
+#include <cstddef>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <pcl/point_types.h>
+#include <pcl/point_cloud.h>
+
+/**
+ * @brief The KittiPointFrame class
+ *
+ * One Velodyne scan stored as structure of arrays: x, y, z and intensity each
+ * in a contiguous float array. pcl::PointXYZI pads every point to 32 bytes
+ * for 16 bytes of data; passes that only need some of the coordinates read a
+ * quarter to a half of that here.
+ *
+ * Every array starts on a 32 byte boundary and is padded with zeros to a
+ * multiple of alignment floats, so vector kernels may load whole registers
+ * past size().
+ *
+ * The PCL code paths get their input through toPointCloud(). This is a
+ * deliberate full copy: pcl::PointCloud stores whole points, so it cannot
+ * view the arrays of a frame. The copy writes into an existing cloud without
+ * reallocating it when the size is unchanged; hot paths should use the frame
+ * directly, like KittiBoxGrid and the index based crops do.
+ */
+class KittiPointFrame : private boost::noncopyable
+{
+
+public:
+
+    typedef boost::shared_ptr<KittiPointFrame> Ptr;
+    typedef boost::shared_ptr<const KittiPointFrame> ConstPtr;
+
+    /** Number of floats every array is padded to */
+    static const std::size_t alignment = 8;
+
+    KittiPointFrame();
+
+    std::size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    std::size_t capacity() const { return _stride; }
+    /** Keeps the storage when shrinking; new points are zero */
+    void resize(std::size_t size);
+    void reserve(std::size_t capacity);
+    void clear() { resize(0); }
+    void push_back(float x, float y, float z, float intensity)
+    {
+        if (_size == _stride)
+            reserve(2 * _stride + alignment);
+        _columns[0][_size] = x;
+        _columns[1][_size] = y;
+        _columns[2][_size] = z;
+        _columns[3][_size] = intensity;
+        ++_size;
+    }
+
+    float* x() { return _columns[0]; }
+    float* y() { return _columns[1]; }
+    float* z() { return _columns[2]; }
+    float* intensity() { return _columns[3]; }
+    const float* x() const { return _columns[0]; }
+    const float* y() const { return _columns[1]; }
+    const float* z() const { return _columns[2]; }
+    const float* intensity() const { return _columns[3]; }
+
+    void toPointCloud(pcl::PointCloud<pcl::PointXYZI>& pointCloud) const;
+    void toPointCloud(const std::vector<int>& indices, pcl::PointCloud<pcl::PointXYZI>& pointCloud) const;
+    void fromPointCloud(const pcl::PointCloud<pcl::PointXYZI>& pointCloud);
+
+private:
+
+    std::size_t _size;
+    std::size_t _stride;
+    std::vector<float> _storage;
+    float* _columns[4];
+};
+
+#endif // KITTIPOINTFRAME_H
@@ -0,0 +1,99 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include "KittiPoseTable.h"
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+namespace
+{
+
+/** Earth radius used by the devkit, in meters */
+const double earthRadius = 6378137.0;
+const double pi = 3.14159265358979323846;
+
+/** Reads latitude, longitude, altitude, roll, pitch and yaw, the first six values of a packet */
+bool readPacket(const std::string& path, double values[6])
+{
+    std::ifstream file(path.c_str());
+    std::string line;
+    if (!file.good() || !std::getline(file, line))
+        return false;
+    return std::sscanf(line.c_str(), "%lf %lf %lf %lf %lf %lf",
+                       &values[0], &values[1], &values[2], &values[3], &values[4], &values[5]) == 6;
+}
+
+}
+
+KittiPoseTable::KittiPoseTable() :
+    _number_of_poses(0)
+{
+}
+
+bool KittiPoseTable::load(const KittiPathTemplate& oxtsPathTemplate, int numberOfFrames,
+                          const Eigen::Affine3d& imuToVelo)
+{
+    _poses.assign(numberOfFrames, Eigen::Affine3d::Identity());
+    _valid.assign(numberOfFrames, false);
+    _number_of_poses = 0;
+
+    Eigen::Affine3d veloToImu = imuToVelo.inverse();
+    Eigen::Affine3d worldFromFirstImu = Eigen::Affine3d::Identity();
+    double scale = 0.0;
+    std::string path;
+    for (int frameId = 0; frameId < numberOfFrames; ++frameId)
+    {
+        double packet[6];
+        oxtsPathTemplate.format(frameId, path);
+        if (!readPacket(path, packet))
+            continue;
+
+        double latitude = packet[0];
+        double longitude = packet[1];
+        if (_number_of_poses == 0)
+            scale = std::cos(latitude * pi / 180.0);
+
+        Eigen::Vector3d translation(scale * longitude * pi * earthRadius / 180.0,
+                                    scale * earthRadius * std::log(std::tan((90.0 + latitude) * pi / 360.0)),
+                                    packet[2]);
+        Eigen::Affine3d imuPose = Eigen::Translation3d(translation)
+                * Eigen::AngleAxisd(packet[5], Eigen::Vector3d::UnitZ())
+                * Eigen::AngleAxisd(packet[4], Eigen::Vector3d::UnitY())
+                * Eigen::AngleAxisd(packet[3], Eigen::Vector3d::UnitX());
+        if (_number_of_poses == 0)
+            worldFromFirstImu = imuPose.inverse();
+
+        _poses[frameId] = worldFromFirstImu * imuPose * veloToImu;
+        _valid[frameId] = true;
+        _number_of_poses++;
+    }
+    return _number_of_poses > 0;
+}
+
+bool KittiPoseTable::hasPose(int frameId) const
+{
+    return frameId >= 0 && frameId < (int) _valid.size() && _valid[frameId];
+}
+
+const Eigen::Affine3d& KittiPoseTable::getPose(int frameId) const
+{
+    static const Eigen::Affine3d identity = Eigen::Affine3d::Identity();
+    return hasPose(frameId) ? _poses[frameId] : identity;
+}
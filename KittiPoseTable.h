@@ -0,0 +1,70 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#ifndef KITTIPOSETABLE_H
+#define KITTIPOSETABLE_H
+
+#include <vector>
+
+#include <eigen3/Eigen/Geometry>
+#include <eigen3/Eigen/StdVector>
+
+#include "KittiConfig.h"
+
+/**
+ * @brief The KittiPoseTable class
+ *
+ * The pose of the Velodyne in every frame of a drive, from the GPS/IMU
+ * (OXTS) packets as described in the readme of the raw data devkit. The
+ * position is projected with the Mercator scale of the first packet, the
+ * orientation is roll, pitch and heading. Every pose maps the Velodyne
+ * coordinates of its frame to world coordinates, whose origin and axes are
+ * those of the IMU in the first frame with a packet: x forward, y left, z up.
+ *
+ * Frames without a packet, or with one that cannot be read, have no pose.
+ */
+class KittiPoseTable
+{
+
+public:
+
+    typedef std::vector<Eigen::Affine3d, Eigen::aligned_allocator<Eigen::Affine3d> > PoseVector;
+
+    KittiPoseTable();
+
+    /**
+     * Reads the packets of frames 0 to numberOfFrames - 1. imuToVelo maps IMU
+     * to Velodyne coordinates, see calib_imu_to_velo.txt. Returns false if no
+     * packet could be read.
+     */
+    bool load(const KittiPathTemplate& oxtsPathTemplate, int numberOfFrames,
+              const Eigen::Affine3d& imuToVelo);
+
+    int getNumberOfFrames() const { return (int) _poses.size(); }
+    int getNumberOfPoses() const { return _number_of_poses; }
+    bool hasPose(int frameId) const;
+    /** Velodyne to world coordinates; identity for frames without a pose */
+    const Eigen::Affine3d& getPose(int frameId) const;
+
+private:
+
+    PoseVector _poses;
+    std::vector<bool> _valid;
+    int _number_of_poses;
+};
+
+#endif // KITTIPOSETABLE_H
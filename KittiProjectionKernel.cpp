@@ -0,0 +1,230 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "KittiProjectionKernel.h"
+
+#include "KittiSimd.h"
+
+void KittiProjectedPoints::reserve(std::size_t capacity)
+{
+    // Growing a std::vector initializes the new elements, so the arrays are
+    // only ever grown, never shrunk to the number of points
+    if (indices.size() < capacity)
+    {
+        u.resize(capacity);
+        v.resize(capacity);
+        depth.resize(capacity);
+        indices.resize(capacity);
+    }
+}
+
+void KittiProjectedPoints::resize(std::size_t size)
+{
+    reserve(size);
+    _size = size;
+}
+
+namespace
+{
+
+/*
+ * The kernels write the kept points at output[count] onwards and return the
+ * new count. The output has room for all points plus one vector block, so
+ * no bounds checks are needed while writing.
+ */
+
+/** Points per block of the vector code the CPU runs, 1 for the scalar code */
+std::size_t detectLanes()
+{
+    if (kittiCpuSupportsAvx2())
+        return 8;
+    if (kittiCpuSupportsSse2())
+        return 4;
+    return 1;
+}
+
+const std::size_t lanes = detectLanes();
+
+std::size_t projectScalar(const float* x, const float* y, const float* z, std::size_t size,
+                          const float* P, float minimumDepth, float width, float height,
+                          KittiProjectedPoints& output)
+{
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        float w = P[8] * x[i] + P[9] * y[i] + P[10] * z[i] + P[11];
+        if (!(w >= minimumDepth))
+            continue;
+        float u = (P[0] * x[i] + P[1] * y[i] + P[2] * z[i] + P[3]) / w;
+        float v = (P[4] * x[i] + P[5] * y[i] + P[6] * z[i] + P[7]) / w;
+        if (u >= 0.0f && u < width && v >= 0.0f && v < height)
+        {
+            output.u[count] = u;
+            output.v[count] = v;
+            output.depth[count] = w;
+            output.indices[count] = (int) i;
+            ++count;
+        }
+    }
+    return count;
+}
+
+#ifdef KITTI_SIMD_X86
+
+inline std::size_t store(unsigned int mask, std::size_t first, const float* u, const float* v, const float* w,
+                         KittiProjectedPoints& output, std::size_t count)
+{
+    while (mask)
+    {
+        int lane = kittiCountTrailingZeros(mask);
+        output.u[count] = u[lane];
+        output.v[count] = v[lane];
+        output.depth[count] = w[lane];
+        output.indices[count] = (int) first + lane;
+        ++count;
+        mask &= mask - 1;
+    }
+    return count;
+}
+
+KITTI_TARGET("sse2")
+std::size_t projectSse2(const float* x, const float* y, const float* z, std::size_t size,
+                        const float* P, float minimumDepth, float width, float height,
+                        KittiProjectedPoints& output)
+{
+    __m128 p[12];
+    for (int i = 0; i < 12; ++i)
+        p[i] = _mm_set1_ps(P[i]);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 minimum = _mm_set1_ps(minimumDepth);
+    const __m128 maximumU = _mm_set1_ps(width);
+    const __m128 maximumV = _mm_set1_ps(height);
+
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < size; i += 4)
+    {
+        __m128 px = _mm_loadu_ps(x + i);
+        __m128 py = _mm_loadu_ps(y + i);
+        __m128 pz = _mm_loadu_ps(z + i);
+        __m128 w = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p[8], px), _mm_mul_ps(p[9], py)),
+                              _mm_add_ps(_mm_mul_ps(p[10], pz), p[11]));
+        __m128 front = _mm_cmpge_ps(w, minimum);
+        if (!_mm_movemask_ps(front))
+            continue;
+        __m128 u = _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(p[0], px), _mm_mul_ps(p[1], py)),
+                                         _mm_add_ps(_mm_mul_ps(p[2], pz), p[3])), w);
+        __m128 v = _mm_div_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(p[4], px), _mm_mul_ps(p[5], py)),
+                                         _mm_add_ps(_mm_mul_ps(p[6], pz), p[7])), w);
+        __m128 inside = _mm_and_ps(
+                    _mm_and_ps(front, _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmplt_ps(u, maximumU))),
+                    _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmplt_ps(v, maximumV)));
+        unsigned int mask = (unsigned int) _mm_movemask_ps(inside) & kittiTailMask(size - i, 4);
+        if (mask)
+        {
+            float us[4], vs[4], ws[4];
+            _mm_storeu_ps(us, u);
+            _mm_storeu_ps(vs, v);
+            _mm_storeu_ps(ws, w);
+            count = store(mask, i, us, vs, ws, output, count);
+        }
+    }
+    return count;
+}
+
+KITTI_TARGET("avx2")
+std::size_t projectAvx2(const float* x, const float* y, const float* z, std::size_t size,
+                        const float* P, float minimumDepth, float width, float height,
+                        KittiProjectedPoints& output)
+{
+    __m256 p[12];
+    for (int i = 0; i < 12; ++i)
+        p[i] = _mm256_set1_ps(P[i]);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 minimum = _mm256_set1_ps(minimumDepth);
+    const __m256 maximumU = _mm256_set1_ps(width);
+    const __m256 maximumV = _mm256_set1_ps(height);
+
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < size; i += 8)
+    {
+        __m256 px = _mm256_loadu_ps(x + i);
+        __m256 py = _mm256_loadu_ps(y + i);
+        __m256 pz = _mm256_loadu_ps(z + i);
+        // Separate multiply and add, no FMA, to round like the scalar code
+        __m256 w = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(p[8], px), _mm256_mul_ps(p[9], py)),
+                                 _mm256_add_ps(_mm256_mul_ps(p[10], pz), p[11]));
+        __m256 front = _mm256_cmp_ps(w, minimum, _CMP_GE_OQ);
+        if (!_mm256_movemask_ps(front))
+            continue;
+        __m256 u = _mm256_div_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(p[0], px), _mm256_mul_ps(p[1], py)),
+                                               _mm256_add_ps(_mm256_mul_ps(p[2], pz), p[3])), w);
+        __m256 v = _mm256_div_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(p[4], px), _mm256_mul_ps(p[5], py)),
+                                               _mm256_add_ps(_mm256_mul_ps(p[6], pz), p[7])), w);
+        __m256 inside = _mm256_and_ps(
+                    _mm256_and_ps(front, _mm256_and_ps(_mm256_cmp_ps(u, zero, _CMP_GE_OQ),
+                                                       _mm256_cmp_ps(u, maximumU, _CMP_LT_OQ))),
+                    _mm256_and_ps(_mm256_cmp_ps(v, zero, _CMP_GE_OQ), _mm256_cmp_ps(v, maximumV, _CMP_LT_OQ)));
+        unsigned int mask = (unsigned int) _mm256_movemask_ps(inside) & kittiTailMask(size - i, 8);
+        if (mask)
+        {
+            float us[8], vs[8], ws[8];
+            _mm256_storeu_ps(us, u);
+            _mm256_storeu_ps(vs, v);
+            _mm256_storeu_ps(ws, w);
+            count = store(mask, i, us, vs, ws, output, count);
+        }
+    }
+    return count;
+}
+
+#endif
+
+}
+
+void KittiProjectionKernel::project(const float* x, const float* y, const float* z, std::size_t size,
+                                    const float veloToImage[12], float minimumDepth, int width, int height,
+                                    KittiProjectedPoints& output)
+{
+    output.reserve(size + 8);
+    std::size_t count;
+#ifdef KITTI_SIMD_X86
+    switch (lanes)
+    {
+    case 8:
+        count = projectAvx2(x, y, z, size, veloToImage, minimumDepth, (float) width, (float) height, output);
+        break;
+    case 4:
+        count = projectSse2(x, y, z, size, veloToImage, minimumDepth, (float) width, (float) height, output);
+        break;
+    default:
+        count = projectScalar(x, y, z, size, veloToImage, minimumDepth, (float) width, (float) height, output);
+        break;
+    }
+#else
+    count = projectScalar(x, y, z, size, veloToImage, minimumDepth, (float) width, (float) height, output);
+#endif
+    output.resize(count);
+}
+
+void KittiProjectionKernel::project(const KittiPointFrame& frame,
+                                    const float veloToImage[12], float minimumDepth, int width, int height,
+                                    KittiProjectedPoints& output)
+{
+    project(frame.x(), frame.y(), frame.z(), frame.size(),
+            veloToImage, minimumDepth, width, height, output);
+}
@@ -0,0 +1,80 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef KITTIPROJECTIONKERNEL_H
+#define KITTIPROJECTIONKERNEL_H
+
+#include <cstddef>
+#include <vector>
+
+#include "KittiPointFrame.h"
+
+/**
+ * @brief Image coordinates of the points that KittiProjectionKernel kept
+ */
+struct KittiProjectedPoints
+{
+    KittiProjectedPoints() : _size(0) {}
+
+    /** Valid up to size(), the arrays keep their length across frames */
+    std::vector<float> u;
+    std::vector<float> v;
+    std::vector<float> depth;
+    /** Index of each projected point in the input */
+    std::vector<int> indices;
+
+    std::size_t size() const { return _size; }
+    /** Makes the arrays at least capacity long, keeping their contents */
+    void reserve(std::size_t capacity);
+    void resize(std::size_t size);
+
+private:
+
+    std::size_t _size;
+};
+
+/**
+ * @brief The KittiProjectionKernel class
+ *
+ * Projects Velodyne points into a camera image with a 3x4 matrix, see
+ * KittiCameraCalibration::veloToImage, and keeps the points in front of the
+ * camera that fall into the image. Like KittiBoxKernel it processes eight
+ * (AVX2) or four (SSE2) points per instruction, using the best instruction
+ * set the CPU supports, see KittiSimd.h.
+ */
+class KittiProjectionKernel
+{
+
+public:
+
+    /**
+     * Replaces output by the points with a depth of at least minimumDepth
+     * whose pixel coordinates lie within [0, width) x [0, height), in
+     * ascending order. The arrays must be readable up to size rounded up to
+     * a multiple of 8, as KittiPointFrame guarantees.
+     */
+    static void project(const float* x, const float* y, const float* z, std::size_t size,
+                        const float veloToImage[12], float minimumDepth, int width, int height,
+                        KittiProjectedPoints& output);
+
+    static void project(const KittiPointFrame& frame,
+                        const float veloToImage[12], float minimumDepth, int width, int height,
+                        KittiProjectedPoints& output);
+};
+
+#endif // KITTIPROJECTIONKERNEL_H
@@ -0,0 +1,495 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "KittiSequenceArchive.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#include <boost/filesystem/operations.hpp>
+
+const unsigned int KittiSequenceArchive::version = 2;
+
+namespace
+{
+
+const char magic[8] = { 'K', 'S', 'E', 'Q', 'A', 'R', 'C', 'H' };
+
+struct Header
+{
+    char magic[8];
+    boost::uint32_t version;
+    boost::uint32_t numberOfFrames;
+};
+
+struct FrameHeader
+{
+    float origin[3];
+    float step[3];
+    boost::uint32_t numberOfPoints;
+    boost::uint32_t encoding;
+};
+
+/** Precedes the stream table of a DELTA_VARINT frame */
+struct ChunkHeader
+{
+    boost::uint32_t chunkSize;
+    boost::uint32_t numberOfStreams;
+};
+
+const int maximumQuantized = 32767;
+
+/** Points per chunk of a compressed frame, a Velodyne scan has about eight */
+const std::size_t chunkSize = 16384;
+/** x, y, z and reflectance */
+const std::size_t streamsPerChunk = 4;
+
+std::size_t alignSize(std::size_t size)
+{
+    return (size + 7) & ~std::size_t(7);
+}
+
+/** Bytes of the coordinate and reflectance columns, padded so the next frame stays aligned */
+std::size_t getColumnsSize(std::size_t numberOfPoints)
+{
+    return alignSize(numberOfPoints * (3 * sizeof(boost::int16_t) + 1));
+}
+
+void quantize(const float* values, std::size_t size, float& origin, float& step, boost::int16_t* quantized)
+{
+    float minimum = std::numeric_limits<float>::max();
+    float maximum = -std::numeric_limits<float>::max();
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        minimum = std::min(minimum, values[i]);
+        maximum = std::max(maximum, values[i]);
+    }
+    if (size == 0)
+        minimum = maximum = 0.0f;
+
+    origin = 0.5f * (minimum + maximum);
+    float halfExtent = 0.5f * (maximum - minimum);
+    step = halfExtent > 0.0f ? halfExtent / maximumQuantized : 1.0f;
+    float scale = 1.0f / step;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        float value = std::floor((values[i] - origin) * scale + 0.5f);
+        value = std::max(-(float) maximumQuantized, std::min((float) maximumQuantized, value));
+        quantized[i] = (boost::int16_t) value;
+    }
+}
+
+void dequantize(const boost::int16_t* quantized, std::size_t size, float origin, float step, float* values)
+{
+    for (std::size_t i = 0; i < size; ++i)
+        values[i] = origin + step * quantized[i];
+}
+
+/** Appends the differences of neighboring values, zigzag and varint coded */
+template <typename T>
+void appendDeltaVarints(const T* values, std::size_t size, std::vector<char>& output)
+{
+    int previous = 0;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        int delta = (int) values[i] - previous;
+        previous = values[i];
+        // Small differences of either sign become small numbers
+        boost::uint32_t code = ((boost::uint32_t) delta << 1) ^ (boost::uint32_t) (delta >> 31);
+        while (code >= 0x80)
+        {
+            output.push_back((char) (code | 0x80));
+            code >>= 7;
+        }
+        output.push_back((char) code);
+    }
+}
+
+/**
+ * Decodes size values written by appendDeltaVarints() and stores value i
+ * as values[i] = offset + scale * value. Fails unless the stream holds
+ * exactly size values, all within [minimum, maximum].
+ */
+bool decodeDeltaVarints(const unsigned char* data, const unsigned char* end, std::size_t size,
+                        int minimum, int maximum, float offset, float scale, float* values)
+{
+    int previous = 0;
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        if (data == end)
+            return false;
+        boost::uint32_t code = *data++;
+        if (code >= 0x80)
+        {
+            code &= 0x7f;
+            for (int shift = 7; ; shift += 7)
+            {
+                if (data == end || shift > 28)
+                    return false;
+                boost::uint32_t byte = *data++;
+                code |= (byte & 0x7f) << shift;
+                if (byte < 0x80)
+                    break;
+            }
+        }
+        // Check the difference before adding it, so a damaged stream cannot overflow previous
+        int delta = (int) (code >> 1) ^ -(int) (code & 1);
+        if (delta < minimum - maximum || delta > maximum - minimum)
+            return false;
+        previous += delta;
+        if (previous < minimum || previous > maximum)
+            return false;
+        values[i] = offset + scale * previous;
+    }
+    return data == end;
+}
+
+bool readPlainFrame(const FrameHeader& header, const char* data, boost::uint64_t size, KittiPointFrame& pointFrame)
+{
+    std::size_t numberOfPoints = header.numberOfPoints;
+    if (getColumnsSize(numberOfPoints) > size)
+        return false;
+
+    const boost::int16_t* columns = reinterpret_cast<const boost::int16_t*>(data);
+    const unsigned char* reflectance = reinterpret_cast<const unsigned char*>(columns + 3 * numberOfPoints);
+    pointFrame.resize(numberOfPoints);
+    dequantize(columns, numberOfPoints, header.origin[0], header.step[0], pointFrame.x());
+    dequantize(columns + numberOfPoints, numberOfPoints, header.origin[1], header.step[1], pointFrame.y());
+    dequantize(columns + 2 * numberOfPoints, numberOfPoints, header.origin[2], header.step[2], pointFrame.z());
+    float* intensity = pointFrame.intensity();
+    for (std::size_t i = 0; i < numberOfPoints; ++i)
+        intensity[i] = reflectance[i] * (1.0f / 255.0f);
+    return true;
+}
+
+bool readDeltaVarintFrame(const FrameHeader& header, const char* data, boost::uint64_t size,
+                          KittiPointFrame& pointFrame, KittiThreadPool* decodePool)
+{
+    std::size_t numberOfPoints = header.numberOfPoints;
+    ChunkHeader chunks;
+    if (size < sizeof(chunks))
+        return false;
+    std::memcpy(&chunks, data, sizeof(chunks));
+    if (chunks.chunkSize == 0
+            || chunks.numberOfStreams != streamsPerChunk * ((numberOfPoints + chunks.chunkSize - 1) / chunks.chunkSize)
+            || sizeof(chunks) + chunks.numberOfStreams * sizeof(boost::uint32_t) > size)
+    {
+        return false;
+    }
+    const boost::uint32_t* streamEnds = reinterpret_cast<const boost::uint32_t*>(data + sizeof(chunks));
+    const unsigned char* streams = reinterpret_cast<const unsigned char*>(streamEnds + chunks.numberOfStreams);
+    boost::uint64_t streamsSize = size - sizeof(chunks) - chunks.numberOfStreams * sizeof(boost::uint32_t);
+    // Every value takes at least one byte, so a damaged header cannot allocate more points than the frame holds
+    if ((boost::uint64_t) numberOfPoints * streamsPerChunk > streamsSize)
+        return false;
+
+    pointFrame.resize(numberOfPoints);
+    float* columns[streamsPerChunk] = { pointFrame.x(), pointFrame.y(), pointFrame.z(), pointFrame.intensity() };
+    const float offsets[streamsPerChunk] = { header.origin[0], header.origin[1], header.origin[2], 0.0f };
+    const float scales[streamsPerChunk] = { header.step[0], header.step[1], header.step[2], 1.0f / 255.0f };
+
+    // Coordinates are int16 and the reflectance uint8, as in a PLAIN frame
+    const int coordinateMinimum = std::numeric_limits<boost::int16_t>::min();
+    const int coordinateMaximum = std::numeric_limits<boost::int16_t>::max();
+    const int minimums[streamsPerChunk] = { coordinateMinimum, coordinateMinimum, coordinateMinimum, 0 };
+    const int maximums[streamsPerChunk] = { coordinateMaximum, coordinateMaximum, coordinateMaximum, 255 };
+
+    // The streams are independent, so the threads of the pool take one each
+    std::atomic<bool> valid(true);
+    KittiThreadPool::Task decode = [&](std::size_t stream)
+    {
+        if (!valid)
+            return;
+        boost::uint32_t begin = stream ? streamEnds[stream - 1] : 0;
+        boost::uint32_t end = streamEnds[stream];
+        std::size_t first = (stream / streamsPerChunk) * chunks.chunkSize;
+        std::size_t count = std::min<std::size_t>(chunks.chunkSize, numberOfPoints - first);
+        std::size_t column = stream % streamsPerChunk;
+        if (begin > end || end > streamsSize
+                || !decodeDeltaVarints(streams + begin, streams + end, count, minimums[column], maximums[column],
+                                       offsets[column], scales[column], columns[column] + first))
+        {
+            valid = false;
+        }
+    };
+
+    if (decodePool)
+    {
+        decodePool->run(chunks.numberOfStreams, decode);
+    }
+    else
+    {
+        for (std::size_t stream = 0; stream < chunks.numberOfStreams; ++stream)
+            decode(stream);
+    }
+    return valid;
+}
+
+}
+
+KittiSequenceArchive::KittiSequenceArchive() :
+    _offsets(NULL),
+    _number_of_frames(0)
+{
+}
+
+bool KittiSequenceArchive::open(const boost::filesystem::path& path)
+{
+    close();
+    try
+    {
+        _file.open(path.string());
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Error in KittiSequenceArchive: Could not map "
+                  << path.string() << ": " << e.what() << std::endl;
+        return false;
+    }
+
+    Header header;
+    bool valid = _file.size() >= sizeof(header);
+    if (valid)
+    {
+        std::memcpy(&header, _file.data(), sizeof(header));
+        valid = std::memcmp(header.magic, magic, sizeof(magic)) == 0
+                && header.version >= 1 && header.version <= version
+                && (_file.size() - sizeof(header)) / sizeof(boost::uint64_t) > header.numberOfFrames;
+    }
+    if (valid)
+    {
+        // Offsets must not decrease and stay within the file, so reading a frame needs no checks
+        _offsets = reinterpret_cast<const boost::uint64_t*>(_file.data() + sizeof(header));
+        boost::uint64_t tableEnd = sizeof(header) + (header.numberOfFrames + 1) * sizeof(boost::uint64_t);
+        valid = _offsets[0] >= tableEnd && _offsets[header.numberOfFrames] <= _file.size();
+        for (boost::uint32_t i = 0; valid && i < header.numberOfFrames; ++i)
+            valid = _offsets[i] <= _offsets[i + 1] && _offsets[i] % 8 == 0;
+    }
+    if (!valid)
+    {
+        std::cerr << "Error in KittiSequenceArchive: " << path.string()
+                  << " is not a sequence archive of version " << version << " or older" << std::endl;
+        close();
+        return false;
+    }
+
+    _number_of_frames = header.numberOfFrames;
+    return true;
+}
+
+void KittiSequenceArchive::close()
+{
+    if (_file.is_open())
+        _file.close();
+    _offsets = NULL;
+    _number_of_frames = 0;
+}
+
+bool KittiSequenceArchive::isOpen() const
+{
+    return _offsets != NULL;
+}
+
+int KittiSequenceArchive::getNumberOfFrames() const
+{
+    return _number_of_frames;
+}
+
+bool KittiSequenceArchive::hasFrame(int frameId) const
+{
+    return frameId >= 0 && frameId < _number_of_frames && _offsets[frameId + 1] > _offsets[frameId];
+}
+
+bool KittiSequenceArchive::readFrame(int frameId, KittiPointFrame& pointFrame, KittiThreadPool* decodePool) const
+{
+    if (!hasFrame(frameId))
+    {
+        pointFrame.clear();
+        return false;
+    }
+
+    const char* data = _file.data() + _offsets[frameId];
+    boost::uint64_t size = _offsets[frameId + 1] - _offsets[frameId];
+    FrameHeader header;
+    bool valid = size >= sizeof(header);
+    if (valid)
+    {
+        std::memcpy(&header, data, sizeof(header));
+        data += sizeof(header);
+        size -= sizeof(header);
+        if (header.encoding == PLAIN)
+            valid = readPlainFrame(header, data, size, pointFrame);
+        else if (header.encoding == DELTA_VARINT)
+            valid = readDeltaVarintFrame(header, data, size, pointFrame, decodePool);
+        else
+            valid = false;
+    }
+    if (!valid)
+    {
+        std::cerr << "Error in KittiSequenceArchive: Frame " << frameId << " is damaged" << std::endl;
+        pointFrame.clear();
+        return false;
+    }
+    return true;
+}
+
+KittiSequenceArchiveWriter::KittiSequenceArchiveWriter() :
+    _encoding(KittiSequenceArchive::PLAIN),
+    _next_frame(0),
+    _size(0)
+{
+}
+
+KittiSequenceArchiveWriter::~KittiSequenceArchiveWriter()
+{
+    // An archive that was not closed is incomplete
+    if (_file.is_open())
+    {
+        _file.close();
+        boost::system::error_code error;
+        boost::filesystem::remove(_temporary_path, error);
+    }
+}
+
+bool KittiSequenceArchiveWriter::open(const boost::filesystem::path& path, int numberOfFrames,
+                                      KittiSequenceArchive::Encoding encoding)
+{
+    if (_file.is_open() || numberOfFrames < 0)
+        return false;
+
+    _path = path;
+    _temporary_path = path;
+    _temporary_path += ".tmp";
+    _file.open(_temporary_path.string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!_file.good())
+        return false;
+
+    // The offsets are filled in by close()
+    _encoding = encoding;
+    _offsets.assign(numberOfFrames + 1, 0);
+    _next_frame = 0;
+    Header header;
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = KittiSequenceArchive::version;
+    header.numberOfFrames = numberOfFrames;
+    _file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    _file.write(reinterpret_cast<const char*>(&_offsets[0]), _offsets.size() * sizeof(boost::uint64_t));
+    _size = sizeof(header) + _offsets.size() * sizeof(boost::uint64_t);
+    return _file.good();
+}
+
+bool KittiSequenceArchiveWriter::addFrame(int frameId, const KittiPointFrame& pointFrame)
+{
+    int numberOfFrames = (int) _offsets.size() - 1;
+    if (!_file.is_open() || frameId < _next_frame || frameId >= numberOfFrames)
+        return false;
+
+    // Skipped frames are empty ranges ending where this frame starts
+    boost::uint64_t offset = getSize();
+    for (int i = _next_frame; i <= frameId; ++i)
+        _offsets[i] = offset;
+    _next_frame = frameId + 1;
+
+    std::size_t numberOfPoints = pointFrame.size();
+    FrameHeader header;
+    header.numberOfPoints = numberOfPoints;
+    header.encoding = KittiSequenceArchive::PLAIN;
+
+    _buffer.assign(getColumnsSize(numberOfPoints), 0);
+    boost::int16_t* columns = reinterpret_cast<boost::int16_t*>(&_buffer[0]);
+    quantize(pointFrame.x(), numberOfPoints, header.origin[0], header.step[0], columns);
+    quantize(pointFrame.y(), numberOfPoints, header.origin[1], header.step[1], columns + numberOfPoints);
+    quantize(pointFrame.z(), numberOfPoints, header.origin[2], header.step[2], columns + 2 * numberOfPoints);
+    unsigned char* reflectance = reinterpret_cast<unsigned char*>(columns + 3 * numberOfPoints);
+    const float* intensity = pointFrame.intensity();
+    for (std::size_t i = 0; i < numberOfPoints; ++i)
+        reflectance[i] = (unsigned char) std::floor(std::max(0.0f, std::min(1.0f, intensity[i])) * 255.0f + 0.5f);
+
+    const std::vector<char>* body = &_buffer;
+    if (_encoding == KittiSequenceArchive::DELTA_VARINT)
+    {
+        _compressed.clear();
+        _stream_ends.clear();
+        for (std::size_t first = 0; first < numberOfPoints; first += chunkSize)
+        {
+            std::size_t count = std::min(chunkSize, numberOfPoints - first);
+            for (std::size_t column = 0; column < 3; ++column)
+            {
+                appendDeltaVarints(columns + column * numberOfPoints + first, count, _compressed);
+                _stream_ends.push_back(_compressed.size());
+            }
+            appendDeltaVarints(reflectance + first, count, _compressed);
+            _stream_ends.push_back(_compressed.size());
+        }
+
+        ChunkHeader chunks;
+        chunks.chunkSize = chunkSize;
+        chunks.numberOfStreams = _stream_ends.size();
+        std::size_t tableSize = sizeof(chunks) + _stream_ends.size() * sizeof(boost::uint32_t);
+        if (alignSize(tableSize + _compressed.size()) < _buffer.size())
+        {
+            header.encoding = KittiSequenceArchive::DELTA_VARINT;
+            _compressed.insert(_compressed.begin(), tableSize, 0);
+            std::memcpy(&_compressed[0], &chunks, sizeof(chunks));
+            if (!_stream_ends.empty())
+                std::memcpy(&_compressed[sizeof(chunks)], &_stream_ends[0], _stream_ends.size() * sizeof(boost::uint32_t));
+            _compressed.resize(alignSize(_compressed.size()), 0);
+            body = &_compressed;
+        }
+    }
+
+    _file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (!body->empty())
+        _file.write(&(*body)[0], body->size());
+    _size += sizeof(header) + body->size();
+    return _file.good();
+}
+
+bool KittiSequenceArchiveWriter::close()
+{
+    if (!_file.is_open())
+        return false;
+
+    boost::uint64_t end = getSize();
+    for (int i = _next_frame; i < (int) _offsets.size(); ++i)
+        _offsets[i] = end;
+    _next_frame = _offsets.size();
+    _file.seekp(sizeof(Header));
+    _file.write(reinterpret_cast<const char*>(&_offsets[0]), _offsets.size() * sizeof(boost::uint64_t));
+    bool written = _file.good();
+    _file.close();
+
+    boost::system::error_code error;
+    if (written)
+        boost::filesystem::rename(_temporary_path, _path, error);
+    if (!written || error)
+    {
+        boost::filesystem::remove(_temporary_path, error);
+        return false;
+    }
+    return true;
+}
+
+boost::uint64_t KittiSequenceArchiveWriter::getSize() const
+{
+    return _size;
+}
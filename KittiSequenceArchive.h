@@ -0,0 +1,150 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef KITTISEQUENCEARCHIVE_H
+#define KITTISEQUENCEARCHIVE_H
+
+#include <cstddef>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include "KittiPointFrame.h"
+#include "KittiThreadPool.h"
+
+/**
+ * @brief The KittiSequenceArchive class
+ *
+ * Reads all Velodyne scans of a drive from a single file. Opening thousands
+ * of small .bin files is slow on network storage, and their four floats per
+ * point are more precise than the sensor. The archive stores every frame
+ * quantized to 16 bit coordinates relative to the center of the bounding
+ * box of the frame, with a step of at most 1/65534 of its extent per axis
+ * (about 1.8 mm for a 120 m wide scan), and the reflectance as 8 bit.
+ *
+ * Frames can also be compressed losslessly on top of that (DELTA_VARINT).
+ * The points are split into chunks, and every column of a chunk is stored
+ * as the differences between neighboring values, zigzag and varint coded.
+ * Neighboring Velodyne returns are close, so most differences take one
+ * byte instead of two. The columns of all chunks are independent streams
+ * and can be decoded on several threads, see readFrame().
+ *
+ * The file is mapped once; reading a frame only looks up its offset and
+ * decodes its columns. Frames may be read from several threads at once.
+ *
+ * File layout (native byte order):
+ *
+ *   Header         magic, version, number of frames
+ *   uint64[]       offset of each frame and the end of the last frame,
+ *                  frame i is stored in [offset[i], offset[i + 1]), an
+ *                  empty range is a missing frame
+ *   Frames         FrameHeader: origin and step per axis, number of points,
+ *                  encoding
+ *                  PLAIN:
+ *                    int16[]  x, y and z of all points, one column each
+ *                    uint8[]  reflectance, padded to 8 bytes
+ *                  DELTA_VARINT:
+ *                    uint32   points per chunk, number of streams
+ *                    uint32[] end of each stream, x, y, z and reflectance
+ *                             of the first chunk, then of the next one
+ *                    char[]   the streams, padded to 8 bytes
+ *
+ * Version 1 archives contain PLAIN frames only and are still read.
+ */
+class KittiSequenceArchive
+{
+
+public:
+
+    /** How the quantized columns of a frame are stored */
+    enum Encoding
+    {
+        PLAIN = 0,
+        DELTA_VARINT = 1
+    };
+
+    KittiSequenceArchive();
+
+    bool open(const boost::filesystem::path& path);
+    void close();
+    bool isOpen() const;
+
+    /** The highest frame number plus one, including missing frames */
+    int getNumberOfFrames() const;
+    bool hasFrame(int frameId) const;
+    /**
+     * Replaces the points of pointFrame; empties it if the frame is missing.
+     * The streams of a compressed frame are decoded on the threads of
+     * decodePool if given, and on the calling thread otherwise.
+     */
+    bool readFrame(int frameId, KittiPointFrame& pointFrame, KittiThreadPool* decodePool = NULL) const;
+
+    static const unsigned int version;
+
+private:
+
+    boost::iostreams::mapped_file_source _file;
+    const boost::uint64_t* _offsets;
+    int _number_of_frames;
+};
+
+/**
+ * @brief The KittiSequenceArchiveWriter class
+ *
+ * Writes a KittiSequenceArchive. Frames are added in ascending order, frame
+ * numbers that are skipped are stored as missing. The archive is written to
+ * a temporary file and only appears under its name once close() succeeds.
+ *
+ * With DELTA_VARINT, frames that would not get smaller are stored PLAIN.
+ */
+class KittiSequenceArchiveWriter
+{
+
+public:
+
+    KittiSequenceArchiveWriter();
+    ~KittiSequenceArchiveWriter();
+
+    bool open(const boost::filesystem::path& path, int numberOfFrames,
+              KittiSequenceArchive::Encoding encoding = KittiSequenceArchive::PLAIN);
+    bool addFrame(int frameId, const KittiPointFrame& pointFrame);
+    bool close();
+
+    /** Bytes written so far */
+    boost::uint64_t getSize() const;
+
+private:
+
+    boost::filesystem::path _path;
+    boost::filesystem::path _temporary_path;
+    std::ofstream _file;
+    KittiSequenceArchive::Encoding _encoding;
+    std::vector<boost::uint64_t> _offsets;
+    int _next_frame;
+    boost::uint64_t _size;
+    /** Reused for the columns of each frame */
+    std::vector<char> _buffer;
+    std::vector<char> _compressed;
+    std::vector<boost::uint32_t> _stream_ends;
+};
+
+#endif // KITTISEQUENCEARCHIVE_H
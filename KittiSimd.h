@@ -0,0 +1,99 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef KITTISIMD_H
+#define KITTISIMD_H
+
+/*
+ * Shared setup of the vectorized kernels, see KittiBoxKernel and
+ * KittiProjectionKernel: CPU detection and helpers for the last block.
+ */
+
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define KITTI_SIMD_X86
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// GCC and Clang only emit vector instructions the target allows; enable them
+// per function so the rest of the build keeps running on any x86 CPU.
+// MSVC accepts the intrinsics without this.
+#if defined(KITTI_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define KITTI_TARGET(instructionSet) __attribute__((target(instructionSet)))
+#else
+#define KITTI_TARGET(instructionSet)
+#endif
+
+inline int kittiCountTrailingZeros(unsigned int bits)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, bits);
+    return (int) index;
+#else
+    return __builtin_ctz(bits);
+#endif
+}
+
+/** Keeps the lanes of the last block that lie before the end of the input */
+inline unsigned int kittiTailMask(std::size_t remaining, std::size_t lanes)
+{
+    return remaining >= lanes ? ~0u : (1u << remaining) - 1u;
+}
+
+inline bool kittiCpuSupportsSse2()
+{
+#if !defined(KITTI_SIMD_X86)
+    return false;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[3] & (1 << 26)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse2");
+#endif
+}
+
+inline bool kittiCpuSupportsAvx2()
+{
+#if !defined(KITTI_SIMD_X86)
+    return false;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maximumLeaf = info[0];
+    __cpuid(info, 1);
+    // AVX registers also need operating system support, see XGETBV
+    bool osAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+    if (!osAvx || maximumLeaf < 7)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // KITTISIMD_H
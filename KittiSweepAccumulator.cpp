@@ -0,0 +1,111 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include "KittiSweepAccumulator.h"
+
+namespace
+{
+
+void transformPoints(const KittiPointFrame& input, const Eigen::Affine3f& transform, KittiPointFrame& output)
+{
+    std::size_t numberOfPoints = input.size();
+    output.resize(numberOfPoints);
+    const Eigen::Matrix3f rotation = transform.linear();
+    const Eigen::Vector3f translation = transform.translation();
+    const float* x = input.x();
+    const float* y = input.y();
+    const float* z = input.z();
+    float* outX = output.x();
+    float* outY = output.y();
+    float* outZ = output.z();
+    for (std::size_t i = 0; i < numberOfPoints; ++i)
+    {
+        outX[i] = rotation(0, 0) * x[i] + rotation(0, 1) * y[i] + rotation(0, 2) * z[i] + translation[0];
+        outY[i] = rotation(1, 0) * x[i] + rotation(1, 1) * y[i] + rotation(1, 2) * z[i] + translation[1];
+        outZ[i] = rotation(2, 0) * x[i] + rotation(2, 1) * y[i] + rotation(2, 2) * z[i] + translation[2];
+    }
+    std::copy(input.intensity(), input.intensity() + numberOfPoints, output.intensity());
+}
+
+}
+
+KittiSweepAccumulator::KittiSweepAccumulator(int numberOfSweeps) :
+    _dataset(-1),
+    _frame_ids(numberOfSweeps < 1 ? 1 : numberOfSweeps, -1),
+    // The sweeps of the window, plus those a viewer still draws
+    _sweep_pool(2 * _frame_ids.size())
+{
+    for (std::size_t i = 0; i < _frame_ids.size(); ++i)
+    {
+        _sweeps.push_back(KittiPointFrame::Ptr(new KittiPointFrame));
+    }
+}
+
+void KittiSweepAccumulator::clear()
+{
+    _dataset = -1;
+    for (std::size_t slot = 0; slot < _sweeps.size(); ++slot)
+    {
+        _frame_ids[slot] = -1;
+        _sweeps[slot] = _sweep_pool.acquire();
+        _sweeps[slot]->clear();
+    }
+}
+
+void KittiSweepAccumulator::update(KittiDataset& dataset, int frameId, const KittiPointFrame& currentPoints,
+                                   std::vector<int>& changedSlots)
+{
+    // After clear() all slots are reported, the viewer may still show their old points
+    changedSlots.clear();
+    bool reset = dataset.getDatasetNumber() != _dataset;
+    if (reset)
+    {
+        clear();
+        _dataset = dataset.getDatasetNumber();
+    }
+
+    // Every slot holds the one sweep of the window with its frame number
+    // modulo the window size, so a sweep that stays in the window is never
+    // moved or overwritten
+    const KittiPoseTable& poses = dataset.getPoses();
+    int numberOfSweeps = getNumberOfSweeps();
+    for (int slot = 0; slot < numberOfSweeps; ++slot)
+    {
+        int sweepId = frameId - ((frameId - slot) % numberOfSweeps + numberOfSweeps) % numberOfSweeps;
+        if (sweepId < 0 || !poses.hasPose(sweepId))
+            sweepId = -1;
+        if (_frame_ids[slot] == sweepId && !reset)
+            continue;
+
+        changedSlots.push_back(slot);
+        _frame_ids[slot] = sweepId;
+        _sweeps[slot] = _sweep_pool.acquire();
+        if (sweepId < 0)
+        {
+            _sweeps[slot]->clear();
+            continue;
+        }
+
+        const KittiPointFrame* points = &currentPoints;
+        if (sweepId != frameId)
+        {
+            dataset.getPointFrame(sweepId, _points);
+            points = &_points;
+        }
+        transformPoints(*points, poses.getPose(sweepId).cast<float>(), *_sweeps[slot]);
+    }
+}
@@ -0,0 +1,76 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#ifndef KITTISWEEPACCUMULATOR_H
+#define KITTISWEEPACCUMULATOR_H
+
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include "KittiBufferPool.h"
+#include "KittiDataset.h"
+#include "KittiPointFrame.h"
+
+/**
+ * @brief The KittiSweepAccumulator class
+ *
+ * Keeps the last numberOfSweeps Velodyne sweeps up to the current frame in
+ * world coordinates, see KittiPoseTable, so they line up into one dense
+ * cloud. The sweeps are stored in a ring of slots keyed by frame number:
+ * stepping one frame ahead transforms only the newest sweep into the slot of
+ * the oldest one, the others are left as they are.
+ *
+ * Frames without a pose leave their slot empty.
+ *
+ * A changed slot gets a new buffer, so the sweeps returned by getSweep()
+ * are never written again and can be drawn on another thread while
+ * update() runs, see KittiSweepLoader.
+ */
+class KittiSweepAccumulator : private boost::noncopyable
+{
+
+public:
+
+    explicit KittiSweepAccumulator(int numberOfSweeps);
+
+    int getNumberOfSweeps() const { return (int) _sweeps.size(); }
+    void clear();
+
+    /**
+     * Moves the window to the sweeps frameId - numberOfSweeps + 1 to frameId
+     * of dataset. currentPoints are the points of frameId, they are not
+     * loaded again. changedSlots receives the slots whose points changed.
+     */
+    void update(KittiDataset& dataset, int frameId, const KittiPointFrame& currentPoints,
+                std::vector<int>& changedSlots);
+
+    /** The frame in a slot, or -1 if the slot is empty */
+    int getFrameId(int slot) const { return _frame_ids.at(slot); }
+    KittiPointFrame::ConstPtr getSweep(int slot) const { return _sweeps.at(slot); }
+
+private:
+
+    int _dataset;
+    std::vector<int> _frame_ids;
+    std::vector<KittiPointFrame::Ptr> _sweeps;
+    KittiBufferPool<KittiPointFrame> _sweep_pool;
+    /** Frames loaded before they are transformed into their slot */
+    KittiPointFrame _points;
+};
+
+#endif // KITTISWEEPACCUMULATOR_H
@@ -0,0 +1,138 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "KittiSweepLoader.h"
+
+#include <QMutexLocker>
+#include <QRunnable>
+
+class KittiSweepLoader::AccumulateTask : public QRunnable
+{
+
+public:
+
+    explicit AccumulateTask(KittiSweepLoader* loader) : _loader(loader) {}
+
+    void run()
+    {
+        _loader->accumulate();
+    }
+
+private:
+
+    KittiSweepLoader* _loader;
+};
+
+KittiSweepLoader::KittiSweepLoader(int numberOfSweeps, QObject* parent) :
+    QObject(parent),
+    _accumulator(numberOfSweeps),
+    _requested(false),
+    _running(false),
+    _dataset(NULL),
+    _frame_id(-1),
+    _ready(false)
+{
+    _number_of_sweeps = _accumulator.getNumberOfSweeps();
+    // One worker, the sweeps of a frame build on those of the previous one
+    _pool.setMaxThreadCount(1);
+}
+
+KittiSweepLoader::~KittiSweepLoader()
+{
+    cancel();
+}
+
+void KittiSweepLoader::request(KittiDataset* dataset, int frameId, const KittiPointFrame::ConstPtr& currentPoints)
+{
+    QMutexLocker locker(&_mutex);
+    _dataset = dataset;
+    _frame_id = frameId;
+    _current_points = currentPoints;
+    _requested = true;
+    if (!_running)
+    {
+        _running = true;
+        _pool.start(new AccumulateTask(this));
+    }
+}
+
+bool KittiSweepLoader::getSweeps(Sweeps& sweeps)
+{
+    QMutexLocker locker(&_mutex);
+    if (!_ready)
+        return false;
+    sweeps = _sweeps;
+    return true;
+}
+
+void KittiSweepLoader::cancel()
+{
+    {
+        QMutexLocker locker(&_mutex);
+        _requested = false;
+        _dataset = NULL;
+        _ready = false;
+        _current_points.reset();
+        _sweeps.points.clear();
+    }
+    _pool.waitForDone();
+    // Sweeps of the previous data set must not outlive it
+    _accumulator.clear();
+}
+
+void KittiSweepLoader::accumulate()
+{
+    QMutexLocker locker(&_mutex);
+    while (_requested)
+    {
+        KittiDataset* dataset = _dataset;
+        int frameId = _frame_id;
+        KittiPointFrame::ConstPtr currentPoints = _current_points;
+        _requested = false;
+        locker.unlock();
+
+        Sweeps sweeps;
+        sweeps.dataset = dataset->getDatasetNumber();
+        sweeps.frameId = frameId;
+        // Reads the OXTS packets on the first request of a data set
+        const KittiPoseTable& poses = dataset->getPoses();
+        sweeps.hasPose = poses.hasPose(frameId);
+        if (sweeps.hasPose)
+        {
+            std::vector<int> changedSlots;
+            _accumulator.update(*dataset, frameId, *currentPoints, changedSlots);
+            sweeps.pose = poses.getPose(frameId);
+            for (int slot = 0; slot < _number_of_sweeps; ++slot)
+            {
+                sweeps.frameIds.push_back(_accumulator.getFrameId(slot));
+                sweeps.points.push_back(_accumulator.getSweep(slot));
+            }
+        }
+
+        locker.relock();
+        // A cancel() or another data set meanwhile drops the result
+        if (_dataset != dataset)
+            continue;
+        _sweeps = sweeps;
+        _ready = true;
+        locker.unlock();
+        emit sweepsReady(sweeps.dataset, sweeps.frameId);
+        locker.relock();
+    }
+    _running = false;
+}
@@ -0,0 +1,103 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef KITTISWEEPLOADER_H
+#define KITTISWEEPLOADER_H
+
+#include <vector>
+
+#include <QMutex>
+#include <QObject>
+#include <QThreadPool>
+
+#include <eigen3/Eigen/Geometry>
+
+#include "KittiDataset.h"
+#include "KittiPointFrame.h"
+#include "KittiSweepAccumulator.h"
+
+/**
+ * @brief The KittiSweepLoader class
+ *
+ * Runs a KittiSweepAccumulator on a worker thread, so neither reading the
+ * OXTS packets nor loading the previous sweeps blocks the GUI thread.
+ * sweepsReady() is emitted, from the worker thread, when the sweeps of a
+ * request are done. Requests that are overtaken by newer ones before the
+ * worker gets to them are dropped.
+ */
+class KittiSweepLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+
+    /** The sweeps up to one frame, see KittiSweepAccumulator */
+    struct Sweeps
+    {
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        int dataset;
+        int frameId;
+        /** Whether frameId has a pose; without one there are no sweeps */
+        bool hasPose;
+        /** Velodyne pose of frameId, the sweeps are in world coordinates */
+        Eigen::Affine3d pose;
+        /** The frame of each slot, -1 if the slot is empty */
+        std::vector<int> frameIds;
+        std::vector<KittiPointFrame::ConstPtr> points;
+    };
+
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    KittiSweepLoader(int numberOfSweeps, QObject* parent = 0);
+    virtual ~KittiSweepLoader();
+
+    int getNumberOfSweeps() const { return _number_of_sweeps; }
+    /** currentPoints are the points of frameId, they are not loaded again */
+    void request(KittiDataset* dataset, int frameId, const KittiPointFrame::ConstPtr& currentPoints);
+    /** The sweeps of the latest finished request; returns false if there are none */
+    bool getSweeps(Sweeps& sweeps);
+    /** Drops a queued request and waits for the worker, e.g. before the data set is deleted */
+    void cancel();
+
+signals:
+
+    void sweepsReady(int dataset, int frameId);
+
+private:
+
+    class AccumulateTask;
+
+    int _number_of_sweeps;
+    QThreadPool _pool;
+    /** Only used by the worker */
+    KittiSweepAccumulator _accumulator;
+
+    QMutex _mutex;
+    bool _requested;
+    bool _running;
+    KittiDataset* _dataset;
+    int _frame_id;
+    KittiPointFrame::ConstPtr _current_points;
+    bool _ready;
+    Sweeps _sweeps;
+
+    void accumulate();
+};
+
+#endif // KITTISWEEPLOADER_H
@@ -0,0 +1,104 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "KittiThreadPool.h"
+
+KittiThreadPool::KittiThreadPool(int numberOfThreads) :
+    _task(NULL),
+    _number_of_tasks(0),
+    _next_task(0),
+    _generation(0),
+    _busy_helpers(0),
+    _stop(false)
+{
+    for (int t = 1; t < numberOfThreads; ++t)
+    {
+        _helpers.push_back(std::thread(&KittiThreadPool::help, this));
+    }
+}
+
+KittiThreadPool::~KittiThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _started.notify_all();
+    for (std::size_t t = 0; t < _helpers.size(); ++t)
+    {
+        _helpers[t].join();
+    }
+}
+
+int KittiThreadPool::getNumberOfThreads() const
+{
+    return (int) _helpers.size() + 1;
+}
+
+void KittiThreadPool::run(std::size_t numberOfTasks, const Task& task)
+{
+    std::unique_lock<std::mutex> runLock(_run_mutex, std::try_to_lock);
+    if (_helpers.empty() || numberOfTasks < 2 || !runLock.owns_lock())
+    {
+        for (std::size_t i = 0; i < numberOfTasks; ++i)
+            task(i);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _task = &task;
+        _number_of_tasks = numberOfTasks;
+        _next_task = 0;
+        _busy_helpers = _helpers.size();
+        ++_generation;
+    }
+    _started.notify_all();
+    runTasks();
+
+    // task must stay valid until every helper has seen the counter run out
+    std::unique_lock<std::mutex> lock(_mutex);
+    _finished.wait(lock, [this]() { return _busy_helpers == 0; });
+    _task = NULL;
+}
+
+void KittiThreadPool::runTasks()
+{
+    for (std::size_t i = _next_task++; i < _number_of_tasks; i = _next_task++)
+    {
+        (*_task)(i);
+    }
+}
+
+void KittiThreadPool::help()
+{
+    unsigned long generation = 0;
+    std::unique_lock<std::mutex> lock(_mutex);
+    for (;;)
+    {
+        _started.wait(lock, [&]() { return _stop || _generation != generation; });
+        if (_stop)
+            return;
+        generation = _generation;
+        lock.unlock();
+        runTasks();
+        lock.lock();
+        if (--_busy_helpers == 0)
+            _finished.notify_one();
+    }
+}
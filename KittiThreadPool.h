@@ -0,0 +1,79 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef KITTITHREADPOOL_H
+#define KITTITHREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+/**
+ * @brief The KittiThreadPool class
+ *
+ * Runs numbered tasks on threads that are started once. run() hands out the
+ * task numbers through an atomic counter, so the helper threads and the
+ * calling thread each take the next task until none is left, and returns
+ * when all tasks are done.
+ *
+ * run() may be called from several threads. While the helpers work for one
+ * caller, other callers run their tasks alone instead of waiting.
+ */
+class KittiThreadPool : private boost::noncopyable
+{
+
+public:
+
+    typedef std::function<void (std::size_t)> Task;
+
+    /** numberOfThreads includes the thread calling run(), so 1 starts no helper */
+    explicit KittiThreadPool(int numberOfThreads);
+    ~KittiThreadPool();
+
+    int getNumberOfThreads() const;
+    /** Calls task(i) for every i below numberOfTasks */
+    void run(std::size_t numberOfTasks, const Task& task);
+
+private:
+
+    std::vector<std::thread> _helpers;
+    /** Held by the caller the helpers work for */
+    std::mutex _run_mutex;
+
+    std::mutex _mutex;
+    std::condition_variable _started;
+    std::condition_variable _finished;
+    const Task* _task;
+    std::size_t _number_of_tasks;
+    std::atomic<std::size_t> _next_task;
+    /** Counts the calls of run() the helpers took part in */
+    unsigned long _generation;
+    std::size_t _busy_helpers;
+    bool _stop;
+
+    void runTasks();
+    void help();
+};
+
+#endif // KITTITHREADPOOL_H
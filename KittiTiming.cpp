@@ -0,0 +1,140 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "KittiTiming.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+KittiStageTimes::KittiStageTimes(std::size_t window) :
+    _window(std::max(window, (std::size_t) 1))
+{
+}
+
+void KittiStageTimes::add(const std::string& stage, double milliseconds)
+{
+    std::map<std::string, Stage>::iterator it = _samples.find(stage);
+    if (it == _samples.end())
+    {
+        _stages.push_back(stage);
+        it = _samples.insert(std::make_pair(stage, Stage())).first;
+        it->second.samples.reserve(_window);
+        it->second.next = 0;
+        it->second.count = 0;
+        it->second.total = 0.0;
+    }
+
+    // Ring buffer of the last _window samples
+    Stage& samples = it->second;
+    if (samples.samples.size() < _window)
+        samples.samples.push_back(milliseconds);
+    else
+        samples.samples[samples.next] = milliseconds;
+    samples.next = (samples.next + 1) % _window;
+    samples.count++;
+    samples.total += milliseconds;
+}
+
+const std::vector<std::string>& KittiStageTimes::getStages() const
+{
+    return _stages;
+}
+
+KittiStageTimes::Summary KittiStageTimes::getSummary(const std::string& stage) const
+{
+    Summary summary = { 0, 0.0, 0.0, 0.0, 0.0 };
+    std::map<std::string, Stage>::const_iterator it = _samples.find(stage);
+    if (it == _samples.end() || it->second.samples.empty())
+        return summary;
+
+    std::vector<double> sorted(it->second.samples);
+    std::sort(sorted.begin(), sorted.end());
+    summary.count = it->second.count;
+    summary.total = it->second.total;
+    summary.p50 = sorted[(sorted.size() - 1) / 2];
+    summary.p95 = sorted[(sorted.size() - 1) * 95 / 100];
+    summary.max = sorted.back();
+    return summary;
+}
+
+std::string KittiStageTimes::toString() const
+{
+    std::stringstream text;
+    text.setf(std::ios::fixed);
+    text.precision(1);
+    for (std::size_t i = 0; i < _stages.size(); ++i)
+    {
+        Summary summary = getSummary(_stages[i]);
+        text << (i ? " | " : "") << _stages[i] << ": "
+             << summary.p50 << "/" << summary.p95 << "/" << summary.max << " ms";
+    }
+    return text.str();
+}
+
+bool KittiStageTimes::writeCsv(const std::string& fileName) const
+{
+    // A reader, or a kill during the write, never sees a truncated file
+    std::string temporaryFileName = fileName + ".tmp";
+    {
+        std::ofstream file(temporaryFileName.c_str());
+        if (!file.good())
+            return false;
+
+        file << "stage,count,total_ms,p50_ms,p95_ms,max_ms" << std::endl;
+        for (std::size_t i = 0; i < _stages.size(); ++i)
+        {
+            Summary summary = getSummary(_stages[i]);
+            file << _stages[i] << ","
+                 << summary.count << ","
+                 << summary.total << ","
+                 << summary.p50 << ","
+                 << summary.p95 << ","
+                 << summary.max << std::endl;
+        }
+        if (!file.good())
+            return false;
+    }
+
+    boost::system::error_code error;
+    boost::filesystem::rename(temporaryFileName, fileName, error);
+    if (error)
+    {
+        boost::filesystem::remove(temporaryFileName, error);
+        return false;
+    }
+    return true;
+}
+
+KittiScopedTimer::KittiScopedTimer(KittiStageTimes& times, const char* stage) :
+    _times(times),
+    _stage(stage),
+    _start(std::chrono::steady_clock::now())
+{
+}
+
+KittiScopedTimer::~KittiScopedTimer()
+{
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - _start;
+    _times.add(_stage, elapsed.count());
+}
@@ -0,0 +1,96 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef KITTITIMING_H
+#define KITTITIMING_H
+
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+/**
+ * @brief The KittiStageTimes class
+ *
+ * Collects the durations of named processing stages and summarizes the most
+ * recent ones of each stage by their median, 95th percentile and maximum.
+ */
+class KittiStageTimes
+{
+
+public:
+
+    struct Summary
+    {
+        /** Number and sum of all samples recorded since the start, not only in the window */
+        std::size_t count;
+        double total;
+        double p50;
+        double p95;
+        double max;
+    };
+
+    KittiStageTimes(std::size_t window = 256);
+
+    void add(const std::string& stage, double milliseconds);
+    /** Stage names in the order they were first recorded */
+    const std::vector<std::string>& getStages() const;
+    Summary getSummary(const std::string& stage) const;
+
+    /** "stage: p50/p95/max ms" of the current window for all stages, separated by " | " */
+    std::string toString() const;
+    /** Replaces fileName through a temporary file, so it can be written repeatedly while samples come in */
+    bool writeCsv(const std::string& fileName) const;
+
+private:
+
+    struct Stage
+    {
+        std::vector<double> samples;
+        std::size_t next;
+        std::size_t count;
+        double total;
+    };
+
+    std::size_t _window;
+    std::vector<std::string> _stages;
+    std::map<std::string, Stage> _samples;
+};
+
+/**
+ * @brief Adds the time between its construction and destruction to a stage
+ */
+class KittiScopedTimer : private boost::noncopyable
+{
+
+public:
+
+    KittiScopedTimer(KittiStageTimes& times, const char* stage);
+    ~KittiScopedTimer();
+
+private:
+
+    KittiStageTimes& _times;
+    const char* _stage;
+    std::chrono::steady_clock::time_point _start;
+};
+
+#endif // KITTITIMING_H
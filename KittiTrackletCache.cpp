@@ -0,0 +1,281 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#include "KittiTrackletCache.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+
+#include "KittiHash.h"
+
+const unsigned int KittiTrackletCache::version = 1;
+
+namespace
+{
+
+const char magic[8] = { 'K', 'T', 'R', 'K', 'C', 'A', 'C', 'H' };
+
+struct Header
+{
+    char magic[8];
+    boost::uint32_t version;
+    boost::uint32_t reserved;
+    boost::uint64_t xmlSize;
+    boost::int64_t xmlModificationTime;
+    boost::uint64_t payloadSize;
+    boost::uint64_t checksum;
+};
+
+struct CachedPose
+{
+    double tx, ty, tz;
+    double rx, ry, rz;
+    boost::int32_t state;
+    boost::int32_t occlusion;
+    boost::int32_t occlusion_kf;
+    boost::int32_t truncation;
+    float amt_occlusion;
+    float amt_border_l;
+    float amt_border_r;
+    boost::int32_t amt_occlusion_kf;
+    boost::int32_t amt_border_kf;
+    boost::int32_t reserved;
+};
+
+bool getXmlStatus(const boost::filesystem::path& xmlPath, boost::uint64_t& size, boost::int64_t& modificationTime)
+{
+    boost::system::error_code error;
+    size = boost::filesystem::file_size(xmlPath, error);
+    if (error)
+        return false;
+    modificationTime = boost::filesystem::last_write_time(xmlPath, error);
+    return !error;
+}
+
+/** Bounds checked sequential reads from the mapped cache file */
+class Reader
+{
+public:
+    Reader(const char* begin, const char* end) : _position(begin), _end(end) {}
+
+    template <typename T> bool read(T& value)
+    {
+        return read(&value, sizeof(T));
+    }
+
+    bool read(void* value, std::size_t size)
+    {
+        if (_end - _position < (std::ptrdiff_t) size)
+            return false;
+        std::memcpy(value, _position, size);
+        _position += size;
+        return true;
+    }
+
+private:
+    const char* _position;
+    const char* _end;
+};
+
+template <typename T> void write(std::vector<char>& buffer, const T& value)
+{
+    const char* data = reinterpret_cast<const char*>(&value);
+    buffer.insert(buffer.end(), data, data + sizeof(T));
+}
+
+}
+
+bool KittiTrackletCache::load(const boost::filesystem::path& cachePath,
+                              const boost::filesystem::path& xmlPath,
+                              Tracklets& tracklets)
+{
+    boost::uint64_t xmlSize;
+    boost::int64_t xmlModificationTime;
+    if (!boost::filesystem::exists(cachePath) || !getXmlStatus(xmlPath, xmlSize, xmlModificationTime))
+        return false;
+
+    boost::iostreams::mapped_file_source file;
+    try
+    {
+        file.open(cachePath.string());
+    }
+    catch (const std::exception&)
+    {
+        return false;
+    }
+
+    Header header;
+    if (file.size() < sizeof(header))
+        return false;
+    std::memcpy(&header, file.data(), sizeof(header));
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0
+            || header.version != version
+            || header.xmlSize != xmlSize
+            || header.xmlModificationTime != xmlModificationTime
+            || header.payloadSize != file.size() - sizeof(header))
+    {
+        return false;
+    }
+
+    const char* payload = file.data() + sizeof(header);
+    if (kittiHash(payload, header.payloadSize) != header.checksum)
+    {
+        std::cerr << "Error in KittiTrackletCache: Checksum mismatch in "
+                  << cachePath.string() << std::endl;
+        return false;
+    }
+
+    Reader reader(payload, payload + header.payloadSize);
+    Tracklets loaded;
+    boost::uint32_t numberOfTracklets;
+    if (!reader.read(numberOfTracklets))
+        return false;
+    for (boost::uint32_t i = 0; i < numberOfTracklets; ++i)
+    {
+        Tracklets::tTracklet tracklet;
+        boost::uint32_t length;
+        boost::int32_t firstFrame, finished;
+        boost::uint32_t numberOfPoses;
+        if (!reader.read(length))
+            return false;
+        tracklet.objectType.resize(length);
+        if ((length && !reader.read(&tracklet.objectType[0], length))
+                || !reader.read(tracklet.h)
+                || !reader.read(tracklet.w)
+                || !reader.read(tracklet.l)
+                || !reader.read(firstFrame)
+                || !reader.read(finished)
+                || !reader.read(numberOfPoses))
+        {
+            return false;
+        }
+        tracklet.first_frame = firstFrame;
+        tracklet.finished = finished;
+
+        tracklet.poses.resize(numberOfPoses);
+        for (boost::uint32_t j = 0; j < numberOfPoses; ++j)
+        {
+            CachedPose cached;
+            if (!reader.read(cached))
+                return false;
+            Tracklets::tPose& pose = tracklet.poses[j];
+            pose.tx = cached.tx;
+            pose.ty = cached.ty;
+            pose.tz = cached.tz;
+            pose.rx = cached.rx;
+            pose.ry = cached.ry;
+            pose.rz = cached.rz;
+            pose.state = (Tracklets::POSE_STATES) cached.state;
+            pose.occlusion = (Tracklets::OCCLUSION_STATES) cached.occlusion;
+            pose.occlusion_kf = cached.occlusion_kf != 0;
+            pose.truncation = (Tracklets::TRUNCATION_STATES) cached.truncation;
+            pose.amt_occlusion = cached.amt_occlusion;
+            pose.amt_border_l = cached.amt_border_l;
+            pose.amt_border_r = cached.amt_border_r;
+            pose.amt_occlusion_kf = cached.amt_occlusion_kf;
+            pose.amt_border_kf = cached.amt_border_kf;
+        }
+        loaded.addTracklet(tracklet);
+    }
+
+    tracklets = loaded;
+    return true;
+}
+
+bool KittiTrackletCache::save(const boost::filesystem::path& cachePath,
+                              const boost::filesystem::path& xmlPath,
+                              Tracklets& tracklets)
+{
+    Header header;
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.reserved = 0;
+    if (!getXmlStatus(xmlPath, header.xmlSize, header.xmlModificationTime))
+        return false;
+
+    std::vector<char> payload;
+    write(payload, (boost::uint32_t) tracklets.numberOfTracklets());
+    for (int i = 0; i < tracklets.numberOfTracklets(); ++i)
+    {
+        const Tracklets::tTracklet& tracklet = *tracklets.getTracklet(i);
+        write(payload, (boost::uint32_t) tracklet.objectType.size());
+        payload.insert(payload.end(), tracklet.objectType.begin(), tracklet.objectType.end());
+        write(payload, tracklet.h);
+        write(payload, tracklet.w);
+        write(payload, tracklet.l);
+        write(payload, (boost::int32_t) tracklet.first_frame);
+        write(payload, (boost::int32_t) tracklet.finished);
+        write(payload, (boost::uint32_t) tracklet.poses.size());
+        for (std::size_t j = 0; j < tracklet.poses.size(); ++j)
+        {
+            const Tracklets::tPose& pose = tracklet.poses[j];
+            CachedPose cached;
+            std::memset(&cached, 0, sizeof(cached));
+            cached.tx = pose.tx;
+            cached.ty = pose.ty;
+            cached.tz = pose.tz;
+            cached.rx = pose.rx;
+            cached.ry = pose.ry;
+            cached.rz = pose.rz;
+            cached.state = pose.state;
+            cached.occlusion = pose.occlusion;
+            cached.occlusion_kf = pose.occlusion_kf ? 1 : 0;
+            cached.truncation = pose.truncation;
+            cached.amt_occlusion = pose.amt_occlusion;
+            cached.amt_border_l = pose.amt_border_l;
+            cached.amt_border_r = pose.amt_border_r;
+            cached.amt_occlusion_kf = pose.amt_occlusion_kf;
+            cached.amt_border_kf = pose.amt_border_kf;
+            write(payload, cached);
+        }
+    }
+    header.payloadSize = payload.size();
+    header.checksum = kittiHash(payload.empty() ? NULL : &payload[0], payload.size());
+
+    // Write to a temporary file first so a concurrent reader never maps a
+    // partially written cache
+    boost::filesystem::path temporaryPath = cachePath;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream file(temporaryPath.string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!file.good())
+            return false;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        if (!payload.empty())
+            file.write(&payload[0], payload.size());
+        if (!file.good())
+            return false;
+    }
+
+    boost::system::error_code error;
+    boost::filesystem::rename(temporaryPath, cachePath, error);
+    if (error)
+    {
+        boost::filesystem::remove(temporaryPath, error);
+        return false;
+    }
+    return true;
+}
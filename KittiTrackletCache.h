@@ -0,0 +1,62 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+#ifndef KITTITRACKLETCACHE_H
+#define KITTITRACKLETCACHE_H
+
+#include <boost/filesystem/path.hpp>
+
+#include "kitti-devkit-raw/tracklets.h"
+
+/**
+ * @brief The KittiTrackletCache class
+ *
+ * Parsing tracklet_labels.xml with the Boost XML archive takes seconds for
+ * long drives. The cache stores the same tracklets in a compact binary file
+ * next to the XML file. It records size and modification time of the XML
+ * file it was created from and a checksum of its contents; a cache that does
+ * not match is ignored.
+ *
+ * File layout (native byte order):
+ *
+ *   Header         magic, version, XML size and mtime, payload size, checksum
+ *   uint32         number of tracklets
+ *   per tracklet:
+ *     uint32       length of the object type, followed by its characters
+ *     float[3]     h, w, l
+ *     int32[2]     first_frame, finished
+ *     uint32       number of poses, followed by that many CachedPose records
+ */
+class KittiTrackletCache
+{
+
+public:
+
+    /** Reads the cache into tracklets if it is valid for the XML file at xmlPath */
+    static bool load(const boost::filesystem::path& cachePath,
+                     const boost::filesystem::path& xmlPath,
+                     Tracklets& tracklets);
+    /** Writes the cache for tracklets loaded from the XML file at xmlPath */
+    static bool save(const boost::filesystem::path& cachePath,
+                     const boost::filesystem::path& xmlPath,
+                     Tracklets& tracklets);
+
+    static const unsigned int version;
+};
+
+#endif // KITTITRACKLETCACHE_H
@@ -0,0 +1,119 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#include "KittiVoxelGrid.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+const boost::uint64_t emptyKey = ~(boost::uint64_t) 0;
+
+/** Voxel coordinates are stored in 21 bits each, about +-100 km at 10 cm leaves */
+const boost::int64_t coordinateRange = 1 << 20;
+
+boost::uint64_t getCoordinateBits(float value)
+{
+    boost::int64_t coordinate = (boost::int64_t) std::floor(value);
+    coordinate = std::max(-coordinateRange, std::min(coordinateRange - 1, coordinate));
+    return (boost::uint64_t) (coordinate + coordinateRange);
+}
+
+std::size_t hashKey(boost::uint64_t key)
+{
+    // Fibonacci hashing, the high bits are well mixed
+    return (std::size_t) ((key * 0x9E3779B97F4A7C15ull) >> 32);
+}
+
+}
+
+KittiVoxelGrid::KittiVoxelGrid(float leafSize) :
+    _leaf_size(leafSize)
+{
+}
+
+void KittiVoxelGrid::filter(const KittiPointFrame& input, KittiPointFrame& output)
+{
+    std::size_t numberOfPoints = input.size();
+    if (_leaf_size <= 0.0f)
+    {
+        output.resize(numberOfPoints);
+        std::copy(input.x(), input.x() + numberOfPoints, output.x());
+        std::copy(input.y(), input.y() + numberOfPoints, output.y());
+        std::copy(input.z(), input.z() + numberOfPoints, output.z());
+        std::copy(input.intensity(), input.intensity() + numberOfPoints, output.intensity());
+        return;
+    }
+
+    // At most half full, so probe sequences stay short
+    std::size_t tableSize = 16;
+    while (tableSize < 2 * numberOfPoints)
+        tableSize *= 2;
+    std::size_t mask = tableSize - 1;
+    _keys.assign(tableSize, emptyKey);
+    _slots.resize(tableSize);
+    _counts.assign(numberOfPoints, 0);
+
+    // The output starts out zero and collects the sums of each voxel
+    output.clear();
+    output.resize(numberOfPoints);
+    const float* x = input.x();
+    const float* y = input.y();
+    const float* z = input.z();
+    const float* intensity = input.intensity();
+    float* sumX = output.x();
+    float* sumY = output.y();
+    float* sumZ = output.z();
+    float* sumIntensity = output.intensity();
+
+    float inverseLeafSize = 1.0f / _leaf_size;
+    boost::uint32_t numberOfVoxels = 0;
+    for (std::size_t i = 0; i < numberOfPoints; ++i)
+    {
+        boost::uint64_t key = getCoordinateBits(x[i] * inverseLeafSize) << 42
+                | getCoordinateBits(y[i] * inverseLeafSize) << 21
+                | getCoordinateBits(z[i] * inverseLeafSize);
+
+        std::size_t bucket = hashKey(key) & mask;
+        while (_keys[bucket] != key && _keys[bucket] != emptyKey)
+            bucket = (bucket + 1) & mask;
+        if (_keys[bucket] == emptyKey)
+        {
+            _keys[bucket] = key;
+            _slots[bucket] = numberOfVoxels++;
+        }
+
+        boost::uint32_t slot = _slots[bucket];
+        sumX[slot] += x[i];
+        sumY[slot] += y[i];
+        sumZ[slot] += z[i];
+        sumIntensity[slot] += intensity[i];
+        _counts[slot]++;
+    }
+
+    for (boost::uint32_t slot = 0; slot < numberOfVoxels; ++slot)
+    {
+        float scale = 1.0f / _counts[slot];
+        sumX[slot] *= scale;
+        sumY[slot] *= scale;
+        sumZ[slot] *= scale;
+        sumIntensity[slot] *= scale;
+    }
+    output.resize(numberOfVoxels);
+}
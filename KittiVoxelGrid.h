@@ -0,0 +1,60 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+#ifndef KITTIVOXELGRID_H
+#define KITTIVOXELGRID_H
+
+#include <cstddef>
+#include <vector>
+
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+
+#include "KittiPointFrame.h"
+
+/**
+ * @brief The KittiVoxelGrid class
+ *
+ * Reduces a frame to one point per occupied cube of leafSize meters, the
+ * centroid of the points in it, like pcl::VoxelGrid does for clouds. The
+ * voxels are found with a hash table instead of sorting the points, so a
+ * frame takes a single pass. The table is kept between calls; use one
+ * instance per thread.
+ *
+ * Points keep the order in which their voxels were first seen.
+ */
+class KittiVoxelGrid : private boost::noncopyable
+{
+
+public:
+
+    explicit KittiVoxelGrid(float leafSize);
+
+    float getLeafSize() const { return _leaf_size; }
+
+    void filter(const KittiPointFrame& input, KittiPointFrame& output);
+
+private:
+
+    float _leaf_size;
+    /** Open addressing table of packed voxel coordinates and their output point */
+    std::vector<boost::uint64_t> _keys;
+    std::vector<boost::uint32_t> _slots;
+    std::vector<boost::uint32_t> _counts;
+};
+
+#endif // KITTIVOXELGRID_H
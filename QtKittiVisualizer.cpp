@@ -19,38 +19,70 @@ limitations under the License.
 #include "QtKittiVisualizer.h"
 #include "ui_QtKittiVisualizer.h"
 
+#include <algorithm>
 #include <string>
 
 #include <QCheckBox>
+#include <QImage>
 #include <QLabel>
 #include <QMainWindow>
+#include <QPainter>
 #include <QSlider>
+#include <QStatusBar>
+#include <QThread>
+#include <QTimer>
 #include <QWidget>
 
 #include <boost/filesystem.hpp>
 #include <boost/program_options.hpp>
 
 #include <eigen3/Eigen/Core>
+#include <eigen3/Eigen/Geometry>
 
 #include <pcl/common/transforms.h>
 #include <pcl/filters/crop_box.h>
 #include <pcl/io/pcd_io.h>
 #include <pcl/point_types.h>
-#include <pcl/visualization/point_cloud_color_handlers.h>
 #include <pcl/visualization/pcl_visualizer.h>
 
+#include <vtkCallbackCommand.h>
+#include <vtkCommand.h>
+
 #include <KittiConfig.h>
 #include <KittiDataset.h>
 
 #include <kitti-devkit-raw/tracklets.h>
 
-typedef pcl::visualization::PointCloudColorHandlerCustom<KittiPoint> KittiPointCloudColorHandlerCustom;
-
 
 // enum for the camera angles
 enum CameraView { front, eye_level, birds_eye, left_pers, right_pers, top };
 static const QString CAMVIEWSTR[] = { "Front", "Eye Level", "Birds Eye", "Left Perspective", "Right Perspective", "Top" };
 
+// Name of a KittiCloudActor::ColorMode value, NULL past the last one. A
+// switch, so the compiler warns about modes without a name.
+static const char* getColorModeName(int mode)
+{
+    switch ((KittiCloudActor::ColorMode) mode)
+    {
+    case KittiCloudActor::UNIFORM:
+        return "uniform";
+    case KittiCloudActor::INTENSITY:
+        return "intensity";
+    case KittiCloudActor::HEIGHT:
+        return "height";
+    case KittiCloudActor::RANGE:
+        return "range";
+    case KittiCloudActor::LABEL:
+        return "label";
+    }
+    return NULL;
+}
+
+// The points are drawn into the image of the left color camera (image_02)
+static const int OVERLAY_CAMERA = 2;
+/** Points closer to the camera plane are not drawn into the image */
+static const float IMAGE_OVERLAY_MINIMUM_DEPTH = 0.5f;
+
 
 
 void usleep(unsigned int usec)
@@ -71,13 +103,39 @@ KittiVisualizerQt::KittiVisualizerQt(QWidget* parent, int argc, char** argv) :
     QMainWindow(parent),
     ui(new Ui::KittiVisualizerQt),
     dataset_index(0),
+    dataset(NULL),
     frame_index(0),
     tracklet_index(0),
+    prefetch_radius(5),
+    prefetcher(NULL),
+    decode_threads(std::max(1, std::min(QThread::idealThreadCount() / 2, 4))),
+    imageCache(NULL),
     pclVisualizer(new pcl::visualization::PCLVisualizer("PCL Visualizer", false)),
     pointCloudVisible(true),
+    point_color_mode(KittiCloudActor::INTENSITY),
+    lod_leaf_size(0.2f),
+    pointCloudReduced(false),
+    lodIdleTimer(NULL),
     trackletBoundingBoxesVisible(true),
     trackletPointsVisible(true),
-    trackletInCenterVisible(true)
+    trackletInCenterVisible(true),
+    accumulatedSweepsVisible(false),
+    accumulated_sweeps(10),
+    sweepLoader(NULL),
+    imageOverlayVisible(true),
+    depthColorMap(0.0f, 60.0f),
+    playback_fps(10.0),
+    playbackTimer(NULL),
+    playbackStartFrame(0),
+    playbackFramesDropped(0),
+    playbackRateFrames(0),
+    playbackAchievedFps(0.0),
+    playbackFrameCost(0.0),
+    timingLabel(NULL),
+    framesStepped(0),
+    framesSteppedAtLabel(0),
+    bufferAllocationsAtLabel(0),
+    bufferAllocationsPerFrame(0.0)
 {
     int invalidOptions = parseCommandLineOptions(argc, argv);
     if (invalidOptions)
@@ -92,27 +150,95 @@ KittiVisualizerQt::KittiVisualizerQt(QWidget* parent, int argc, char** argv) :
     }
 
     ui->toolBar->addWidget(ui->viewComboBox);
+    for (int i = 0; getColorModeName(i); i++) {
+        ui->colorComboBox->addItem(QString("Color: ") + getColorModeName(i));
+    }
+    ui->colorComboBox->setCurrentIndex(point_color_mode);
+    ui->toolBar->addWidget(ui->colorComboBox);
     ui->qvtkWidget_pclViewer->SetRenderWindow(pclVisualizer->getRenderWindow());
     pclVisualizer->initCameraParameters();
     pclVisualizer->setupInteractor(ui->qvtkWidget_pclViewer->GetInteractor(), ui->qvtkWidget_pclViewer->GetRenderWindow());
     pclVisualizer->setBackgroundColor(0, 0, 0);
     pclVisualizer->addCoordinateSystem(1.0);
+
+    vtkSmartPointer<vtkRenderer> renderer = pclVisualizer->getRendererCollection()->GetFirstRenderer();
+    pointCloudActor.reset(new KittiCloudActor(renderer));
+    reducedPointCloudActor.reset(new KittiCloudActor(renderer));
+    pointCloudActor->setColorMode(point_color_mode);
+    reducedPointCloudActor->setColorMode(point_color_mode);
+    trackletBoxActor.reset(new KittiBoxActor(renderer));
+    sweepLoader = new KittiSweepLoader(accumulated_sweeps, this);
+    connect(sweepLoader, SIGNAL (sweepsReady(int, int)), this, SLOT (sweepsLoaded(int, int)));
+    for (int i = 0; i < sweepLoader->getNumberOfSweeps(); ++i)
+    {
+        sweepActors.push_back(KittiCloudActor::Ptr(new KittiCloudActor(renderer)));
+        sweepActors.back()->setColorMode(getSweepColorMode());
+    }
+    shownSweeps.resize(sweepActors.size());
+    trackletInCenterActor.reset(new KittiCloudActor(renderer));
+    trackletInCenterActor->setColor(0, 255, 0);
     
     pclVisualizer->registerKeyboardCallback(&KittiVisualizerQt::keyboardEventOccurred, *this, 0);
+
+    vtkSmartPointer<vtkCallbackCommand> renderCallback = vtkSmartPointer<vtkCallbackCommand>::New();
+    renderCallback->SetCallback(&KittiVisualizerQt::renderEventOccurred);
+    renderCallback->SetClientData(this);
+    pclVisualizer->getRenderWindow()->AddObserver(vtkCommand::StartEvent, renderCallback);
+    pclVisualizer->getRenderWindow()->AddObserver(vtkCommand::EndEvent, renderCallback);
+
+    // Switch to the reduced cloud while the user orbits, pans or zooms
+    vtkSmartPointer<vtkCallbackCommand> interactionCallback = vtkSmartPointer<vtkCallbackCommand>::New();
+    interactionCallback->SetCallback(&KittiVisualizerQt::interactionEventOccurred);
+    interactionCallback->SetClientData(this);
+    pclVisualizer->getInteractorStyle()->AddObserver(vtkCommand::StartInteractionEvent, interactionCallback);
+    pclVisualizer->getInteractorStyle()->AddObserver(vtkCommand::EndInteractionEvent, interactionCallback);
+    lodIdleTimer = new QTimer(this);
+    lodIdleTimer->setSingleShot(true);
+    lodIdleTimer->setInterval(300);
+    connect(lodIdleTimer, SIGNAL (timeout()), this, SLOT (lodIdleTimeout()));
+
+    timingLabel = new QLabel(this);
+    ui->statusBar->addPermanentWidget(timingLabel);
+    timingLabelClock.start();
+    timingCsvClock.start();
     this->setWindowTitle("Qt KITTI Visualizer");
     ui->qvtkWidget_pclViewer->update();
 
+    imageWidgets.push_back(ui->imageWidget_00);
+    imageWidgets.push_back(ui->imageWidget_01);
+    imageWidgets.push_back(ui->imageWidget_02);
+    imageWidgets.push_back(ui->imageWidget_03);
+    cameraCheckBoxes.push_back(ui->checkBox_showCamera0);
+    cameraCheckBoxes.push_back(ui->checkBox_showCamera1);
+    cameraCheckBoxes.push_back(ui->checkBox_showCamera2);
+    cameraCheckBoxes.push_back(ui->checkBox_showCamera3);
+    for (int camera = 0; camera < KittiConfig::numberOfCameras; ++camera)
+    {
+        cameraVisible.push_back(cameraCheckBoxes[camera]->isChecked());
+        imageWidgets[camera]->setVisible(cameraVisible[camera]);
+    }
+
     // Init the viewer with the first point cloud and corresponding tracklets
     dataset = new KittiDataset(KittiConfig::availableDatasets.at(dataset_index));
+    dataset->setDecodeThreads(decode_threads);
+    // Tracklet points are shown 6 m above the cloud
+    prefetcher = new KittiFramePrefetcher(prefetch_radius, Eigen::Vector3f(0.0f, 0.0f, 6.0f), lod_leaf_size);
+    prefetcher->setDataset(dataset);
+    imageCache = new KittiImageCache(4 * prefetch_radius + 2);
+    connect(imageCache, SIGNAL (imageReady(int, int, int)), this, SLOT (imageDecoded(int, int, int)));
+    loadFrame();
     loadPointCloud();
     if (pointCloudVisible)
         showPointCloud();
+    if (accumulatedSweepsVisible)
+        showAccumulatedSweeps();
 
     loadImageFile();
 
     loadAvailableTracklets();
     if (trackletBoundingBoxesVisible)
         showTrackletBoxes();
+    updateImageOverlay();
     loadTrackletPoints();
     if (trackletPointsVisible)
         showTrackletPoints();
@@ -141,8 +267,21 @@ KittiVisualizerQt::KittiVisualizerQt(QWidget* parent, int argc, char** argv) :
     connect(ui->checkBox_showTrackletBoundingBoxes, SIGNAL (toggled(bool)), this, SLOT (showTrackletBoundingBoxesToggled(bool)));
     connect(ui->checkBox_showTrackletPointClouds,   SIGNAL (toggled(bool)), this, SLOT (showTrackletPointCloudsToggled(bool)));
     connect(ui->checkBox_showTrackletInCenter,      SIGNAL (toggled(bool)), this, SLOT (showTrackletInCenterToggled(bool)));
+    connect(ui->checkBox_showAccumulatedSweeps,     SIGNAL (toggled(bool)), this, SLOT (showAccumulatedSweepsToggled(bool)));
+    connect(ui->checkBox_showImageOverlay,          SIGNAL (toggled(bool)), this, SLOT (showImageOverlayToggled(bool)));
+    for (int camera = 0; camera < KittiConfig::numberOfCameras; ++camera)
+    {
+        connect(cameraCheckBoxes[camera],           SIGNAL (toggled(bool)), this, SLOT (showCamerasToggled()));
+    }
     connect(ui->actionExit,                         SIGNAL (triggered()),   this, SLOT (exitApplication()));
     connect(ui->viewComboBox,                       SIGNAL (activated(int)),this, SLOT (camViewChanged(int)));
+    connect(ui->colorComboBox,                      SIGNAL (activated(int)),this, SLOT (colorModeChanged(int)));
+    connect(ui->actionPlay,                         SIGNAL (toggled(bool)), this, SLOT (playbackToggled(bool)));
+
+    // Poll at twice the frame rate so timer jitter does not halve the playback rate
+    playbackTimer = new QTimer(this);
+    playbackTimer->setInterval(std::max(1, (int) (500.0 / playback_fps)));
+    connect(playbackTimer,                          SIGNAL (timeout()),     this, SLOT (playbackTimerTimeout()));
     
     ui->viewComboBox->setCurrentIndex(CameraView::birds_eye);
     camViewChanged(CameraView::birds_eye);
@@ -150,6 +289,15 @@ KittiVisualizerQt::KittiVisualizerQt(QWidget* parent, int argc, char** argv) :
 
 KittiVisualizerQt::~KittiVisualizerQt()
 {
+    if (!timing_csv_file.empty())
+    {
+        if (writeTimingCsv())
+            std::cout << "Wrote frame timing to " << timing_csv_file << "." << std::endl;
+    }
+
+    delete imageCache;
+    delete prefetcher;
+    sweepLoader->cancel();
     delete dataset;
     delete ui;
 }
@@ -160,7 +308,17 @@ int KittiVisualizerQt::parseCommandLineOptions(int argc, char** argv)
     boost::program_options::options_description desc("Program options");
     desc.add_options()
         ("help", "Produce this help message.")
-        ("dataset", boost::program_options::value<int>(), "Set the number of the KITTI data set to be used.")
+        ("data-directory", boost::program_options::value<std::string>(), "Set the folder containing the KITTI raw data sets.")
+        ("rescan", "Search the data directory for data sets even if a manifest exists.")
+        ("dataset", boost::program_options::value<int>(), "Set the KITTI data set to be used by its drive number, plus 10000 for each earlier recording date if there are several.")
+        ("prefetch", boost::program_options::value<int>(), "Set the number of frames loaded in the background ahead of and behind the current frame.")
+        ("fps", boost::program_options::value<double>(), "Set the target frame rate of the playback mode (default 10).")
+        ("color", boost::program_options::value<std::string>(), "Color the points by uniform, intensity (default), height, range or label (the tracklet they belong to).")
+        ("sweeps", boost::program_options::value<int>(), "Set the number of sweeps shown by the accumulated view, including the current one (default 10).")
+        ("lod-leaf-size", boost::program_options::value<float>(), "Set the voxel size in meters of the reduced cloud shown while the camera moves (default 0.2, 0 always shows all points).")
+        ("timing-csv", boost::program_options::value<std::string>(), "Write the frame stage timing statistics to this CSV file every 10 seconds and on exit.")
+        ("no-archive", "Load the .bin files even if a data set has a sequence archive.")
+        ("decode-threads", boost::program_options::value<int>(), "Set the number of threads decoding a compressed archive frame (default: half the cores, at most 4).")
     ;
 
     boost::program_options::variables_map vm;
@@ -172,6 +330,14 @@ int KittiVisualizerQt::parseCommandLineOptions(int argc, char** argv)
         return 1;
     }
 
+    if (vm.count("data-directory")) {
+        KittiConfig::setDataDirectory(vm["data-directory"].as<std::string>());
+    }
+    if (!KittiConfig::initAvailableDatasets(vm.count("rescan") > 0)) {
+        return 1;
+    }
+    KittiConfig::setSequenceArchiveEnabled(vm.count("no-archive") == 0);
+
     if (vm.count("dataset")) {
         dataset_index = vm["dataset"].as<int>();
         std::cout << "Using data set " << dataset_index << "." << std::endl;
@@ -181,6 +347,53 @@ int KittiVisualizerQt::parseCommandLineOptions(int argc, char** argv)
         std::cout << "Data set was not specified." << std::endl;
         std::cout << "Using data set " << KittiConfig::getDatasetNumber(dataset_index) << "." << std::endl;
     }
+
+    if (vm.count("prefetch")) {
+        prefetch_radius = vm["prefetch"].as<int>();
+    }
+    if (vm.count("decode-threads")) {
+        decode_threads = std::max(1, vm["decode-threads"].as<int>());
+    }
+
+    if (vm.count("timing-csv")) {
+        timing_csv_file = vm["timing-csv"].as<std::string>();
+    }
+
+    if (vm.count("color")) {
+        std::string name = vm["color"].as<std::string>();
+        int mode = 0;
+        while (getColorModeName(mode) && name != getColorModeName(mode))
+            mode++;
+        if (!getColorModeName(mode)) {
+            std::cerr << "Unknown color mode " << name << "." << std::endl;
+            return 1;
+        }
+        point_color_mode = (KittiCloudActor::ColorMode) mode;
+    }
+
+    if (vm.count("sweeps")) {
+        accumulated_sweeps = vm["sweeps"].as<int>();
+        if (accumulated_sweeps < 1) {
+            std::cerr << "At least one sweep has to be accumulated." << std::endl;
+            return 1;
+        }
+    }
+
+    if (vm.count("lod-leaf-size")) {
+        lod_leaf_size = vm["lod-leaf-size"].as<float>();
+        if (lod_leaf_size < 0.0f) {
+            std::cerr << "The voxel size of the reduced cloud must not be negative." << std::endl;
+            return 1;
+        }
+    }
+
+    if (vm.count("fps")) {
+        playback_fps = vm["fps"].as<double>();
+        if (playback_fps <= 0.0) {
+            std::cerr << "The playback frame rate has to be positive." << std::endl;
+            return 1;
+        }
+    }
     return 0;
 }
 
@@ -212,6 +425,9 @@ void KittiVisualizerQt::showFramePointCloudToggled(bool value)
     {
         hidePointCloud();
     }
+    // The current sweep is only shown by the accumulated view without the frame cloud
+    if (accumulatedSweepsVisible)
+        showAccumulatedSweeps();
     ui->qvtkWidget_pclViewer->update();
 }
 
@@ -228,6 +444,8 @@ void KittiVisualizerQt::newDatasetRequested(int value)
     if (trackletBoundingBoxesVisible)
         hideTrackletBoxes();
     clearAvailableTracklets();
+    if (accumulatedSweepsVisible)
+        hideAccumulatedSweeps();
     if (pointCloudVisible)
         hidePointCloud();
 
@@ -237,19 +455,29 @@ void KittiVisualizerQt::newDatasetRequested(int value)
     if (dataset_index < 0)
         dataset_index = 0;
 
+    prefetcher->setDataset(NULL);
+    sweepLoader->cancel();
+    shownSweeps.assign(shownSweeps.size(), KittiPointFrame::ConstPtr());
     delete dataset;
     dataset = new KittiDataset(KittiConfig::availableDatasets.at(dataset_index));
+    dataset->setDecodeThreads(decode_threads);
+    bufferAllocationsAtLabel = 0;
+    prefetcher->setDataset(dataset);
 
     if (frame_index >= dataset->getNumberOfFrames())
         frame_index = dataset->getNumberOfFrames() - 1;
 
+    loadFrame();
     loadPointCloud();
     if (pointCloudVisible)
         showPointCloud();
+    if (accumulatedSweepsVisible)
+        showAccumulatedSweeps();
     loadImageFile();
     loadAvailableTracklets();
     if (trackletBoundingBoxesVisible)
         showTrackletBoxes();
+    updateImageOverlay();
     loadTrackletPoints();
     if (trackletPointsVisible)
         showTrackletPoints();
@@ -272,7 +500,6 @@ void KittiVisualizerQt::newDatasetRequested(int value)
     updateFrameLabel();
     updateTrackletLabel();
     ui->qvtkWidget_pclViewer->update();
-    ui->imageWidget->update();
 }
 
 void KittiVisualizerQt::newFrameRequested(int value)
@@ -280,6 +507,9 @@ void KittiVisualizerQt::newFrameRequested(int value)
     if (frame_index == value)
         return;
 
+    KittiScopedTimer timer(stageTimes, "frame step");
+    framesStepped++;
+
     if (trackletInCenterVisible)
         hideTrackletInCenter();
     if (trackletPointsVisible)
@@ -288,6 +518,8 @@ void KittiVisualizerQt::newFrameRequested(int value)
     if (trackletBoundingBoxesVisible)
         hideTrackletBoxes();
     clearAvailableTracklets();
+    if (accumulatedSweepsVisible)
+        hideAccumulatedSweeps();
     if (pointCloudVisible)
         hidePointCloud();
 
@@ -297,13 +529,17 @@ void KittiVisualizerQt::newFrameRequested(int value)
     if (frame_index < 0)
         frame_index = 0;
 
+    loadFrame();
     loadPointCloud();
     if (pointCloudVisible)
         showPointCloud();
+    if (accumulatedSweepsVisible)
+        showAccumulatedSweeps();
     loadImageFile();
     loadAvailableTracklets();
     if (trackletBoundingBoxesVisible)
         showTrackletBoxes();
+    updateImageOverlay();
     loadTrackletPoints();
     if (trackletPointsVisible)
         showTrackletPoints();
@@ -356,6 +592,7 @@ void KittiVisualizerQt::showTrackletBoundingBoxesToggled(bool value)
     {
         hideTrackletBoxes();
     }
+    updateImageOverlay();
     ui->qvtkWidget_pclViewer->update();
 }
 
@@ -387,47 +624,363 @@ void KittiVisualizerQt::showTrackletInCenterToggled(bool value)
     ui->qvtkWidget_pclViewer->update();
 }
 
+void KittiVisualizerQt::showAccumulatedSweepsToggled(bool value)
+{
+    accumulatedSweepsVisible = value;
+    if (accumulatedSweepsVisible)
+    {
+        showAccumulatedSweeps();
+    }
+    else
+    {
+        hideAccumulatedSweeps();
+    }
+    ui->qvtkWidget_pclViewer->update();
+}
+
+void KittiVisualizerQt::showImageOverlayToggled(bool value)
+{
+    imageOverlayVisible = value;
+    updateImageOverlay();
+}
+
+void KittiVisualizerQt::loadFrame()
+{
+    KittiScopedTimer timer(stageTimes, "load frame");
+    frame = prefetcher->getFrame(frame_index);
+    prefetcher->prefetch(frame_index);
+}
+
 void KittiVisualizerQt::loadPointCloud()
 {
-    pointCloud = dataset->getPointCloud(frame_index);
+    pointFrame = frame->pointFrame;
 }
 
 void KittiVisualizerQt::loadImageFile()
 {
-    ui->imageWidget->setPixmapFile(dataset->getImageFileName(frame_index));
-    ui->imageWidget->repaint();
-    std::cout << "loaded:" << dataset->getImageFileName(frame_index) << std::endl;
+    KittiScopedTimer timer(stageTimes, "load image");
+    int datasetNumber = dataset->getDatasetNumber();
+    imageCache->setWindow(datasetNumber, frame_index - prefetch_radius, frame_index + prefetch_radius);
+
+    std::vector<int> cameras;
+    for (int camera = 0; camera < KittiConfig::numberOfCameras; ++camera)
+    {
+        if (!cameraVisible.at(camera))
+            continue;
+        if (!dataset->hasImages(camera))
+        {
+            imageWidgets.at(camera)->setImage(QImage());
+            continue;
+        }
+        cameras.push_back(camera);
+
+        // Show the image right away if it is decoded, otherwise imageDecoded() shows it later
+        KittiImageKey key(datasetNumber, camera, frame_index);
+        QImage image;
+        if (imageCache->getImage(key, image))
+            imageWidgets.at(camera)->setImage(image);
+        else
+            imageCache->requestImage(key, dataset->getImageFileName(camera, frame_index));
+    }
+
+    // Decode the images of the surrounding frames, closest first, all cameras of a frame together
+    for (int distance = 1; distance <= prefetch_radius; ++distance)
+    {
+        for (std::size_t i = 0; i < cameras.size(); ++i)
+        {
+            int camera = cameras[i];
+            if (frame_index + distance < dataset->getNumberOfFrames())
+                imageCache->requestImage(KittiImageKey(datasetNumber, camera, frame_index + distance),
+                                         dataset->getImageFileName(camera, frame_index + distance));
+            if (frame_index - distance >= 0)
+                imageCache->requestImage(KittiImageKey(datasetNumber, camera, frame_index - distance),
+                                         dataset->getImageFileName(camera, frame_index - distance));
+        }
+    }
+}
+
+void KittiVisualizerQt::imageDecoded(int datasetNumber, int camera, int frameId)
+{
+    if (datasetNumber != dataset->getDatasetNumber() || frameId != frame_index
+            || camera < 0 || camera >= (int) cameraVisible.size() || !cameraVisible[camera])
+    {
+        return;
+    }
+
+    QImage image;
+    if (imageCache->getImage(KittiImageKey(datasetNumber, camera, frameId), image))
+        imageWidgets.at(camera)->setImage(image);
+}
+
+void KittiVisualizerQt::showCamerasToggled()
+{
+    bool anyCameraVisible = false;
+    for (int camera = 0; camera < KittiConfig::numberOfCameras; ++camera)
+    {
+        bool visible = cameraCheckBoxes.at(camera)->isChecked();
+        if (!visible && cameraVisible.at(camera))
+        {
+            // Keeps a hidden camera from briefly showing an old frame when it is enabled again
+            imageWidgets.at(camera)->setImage(QImage());
+        }
+        cameraVisible.at(camera) = visible;
+        imageWidgets.at(camera)->setVisible(visible);
+        anyCameraVisible = anyCameraVisible || visible;
+    }
+    ui->imagePanel->setVisible(anyCameraVisible);
+    loadImageFile();
+    updateImageOverlay();
 }
 
 void KittiVisualizerQt::showPointCloud()
 {
-    KittiPointCloudColorHandlerCustom colorHandler(pointCloud, 255, 255, 255);
-    pclVisualizer->addPointCloud<KittiPoint>(pointCloud, colorHandler, "point_cloud");
+    KittiScopedTimer timer(stageTimes, "show cloud");
+    if (pointCloudReduced && !frame->reducedPointFrame)
+    {
+        // Loaded on a cache miss, the prefetcher may have reduced it meanwhile.
+        // This runs as the camera starts moving, so never load the frame here.
+        KittiFrame::Ptr residentFrame = prefetcher->getResidentFrame(frame_index);
+        if (residentFrame && residentFrame->pointFrame == frame->pointFrame)
+            frame = residentFrame;
+    }
+
+    bool reduced = pointCloudReduced && frame->reducedPointFrame;
+    if (reduced && shownReducedPointFrame != frame->reducedPointFrame)
+    {
+        shownReducedPointFrame = frame->reducedPointFrame;
+        reducedPointCloudActor->setPointFrame(*shownReducedPointFrame);
+    }
+    else if (!reduced && shownPointFrame != pointFrame)
+    {
+        shownPointFrame = pointFrame;
+        // Labels and points in one call, so the label colors are computed once
+        updateLabelColors();
+        pointCloudActor->setPointFrame(*shownPointFrame, *frame->trackletPointIndices);
+    }
+    pointCloudActor->setVisible(!reduced);
+    reducedPointCloudActor->setVisible(reduced);
 }
 
 void KittiVisualizerQt::hidePointCloud()
 {
-    pclVisualizer->removePointCloud("point_cloud");
+    pointCloudActor->setVisible(false);
+    reducedPointCloudActor->setVisible(false);
 }
 
-void KittiVisualizerQt::loadAvailableTracklets()
+void KittiVisualizerQt::updateLabelColors()
+{
+    // The reduced cloud has no labels, its points are centroids of voxels
+    KittiActiveTracklets tracklets = dataset->getActiveTracklets(frame_index);
+    for (int i = 0; i < tracklets.size(); ++i)
+    {
+        int r, g, b;
+        getTrackletColor(tracklets.at(i), r, g, b);
+        pointCloudActor->setLabelColor(i, r, g, b);
+    }
+}
+
+void KittiVisualizerQt::colorModeChanged(int index)
+{
+    point_color_mode = (KittiCloudActor::ColorMode) index;
+    pointCloudActor->setColorMode(point_color_mode);
+    reducedPointCloudActor->setColorMode(point_color_mode);
+    for (std::size_t slot = 0; slot < sweepActors.size(); ++slot)
+    {
+        sweepActors[slot]->setColorMode(getSweepColorMode());
+    }
+    ui->qvtkWidget_pclViewer->update();
+}
+
+void KittiVisualizerQt::lodIdleTimeout()
+{
+    pointCloudReduced = false;
+    if (pointCloudVisible)
+        showPointCloud();
+    ui->qvtkWidget_pclViewer->update();
+}
+
+void KittiVisualizerQt::interactionEventOccurred(vtkObject* caller, unsigned long eventId,
+                                                 void* clientData, void* callData)
+{
+    KittiVisualizerQt* visualizer = static_cast<KittiVisualizerQt*>(clientData);
+    if (visualizer->lod_leaf_size <= 0.0f)
+        return;
+
+    if (eventId == vtkCommand::StartInteractionEvent)
+    {
+        // Called before the first render of the camera move
+        visualizer->lodIdleTimer->stop();
+        if (!visualizer->pointCloudReduced)
+        {
+            visualizer->pointCloudReduced = true;
+            if (visualizer->pointCloudVisible)
+                visualizer->showPointCloud();
+        }
+    }
+    else if (eventId == vtkCommand::EndInteractionEvent)
+    {
+        // Mouse wheel zooms end right away, stay reduced while they follow each other
+        visualizer->lodIdleTimer->start();
+    }
+}
+
+void KittiVisualizerQt::showAccumulatedSweeps()
+{
+    // Loading the poses and the previous sweeps takes too long for the GUI
+    // thread; sweepsLoaded() shows them once they are done
+    sweepLoader->request(dataset, frame_index, pointFrame);
+}
+
+void KittiVisualizerQt::sweepsLoaded(int datasetNumber, int frameId)
 {
-    Tracklets& tracklets = dataset->getTracklets();
-    int tracklet_id;
-    int number_of_tracklets = tracklets.numberOfTracklets();
-    for (tracklet_id = 0; tracklet_id < number_of_tracklets; tracklet_id++)
+    if (!accumulatedSweepsVisible || datasetNumber != dataset->getDatasetNumber() || frameId != frame_index)
+        return;
+
+    KittiSweepLoader::Sweeps sweeps;
+    if (!sweepLoader->getSweeps(sweeps) || sweeps.dataset != datasetNumber || sweeps.frameId != frameId)
+        return;
+
+    KittiScopedTimer timer(stageTimes, "accumulate sweeps");
+    if (!sweeps.hasPose)
+    {
+        hideAccumulatedSweeps();
+        ui->qvtkWidget_pclViewer->update();
+        return;
+    }
+
+    // Stepping ahead changes only the newest sweep
+    for (int slot = 0; slot < sweepLoader->getNumberOfSweeps(); ++slot)
     {
-        KittiTracklet* tracklet = tracklets.getTracklet(tracklet_id);
-        if (tracklet->first_frame <= frame_index && tracklet->lastFrame() >= frame_index)
+        if (shownSweeps.at(slot) != sweeps.points.at(slot))
         {
-            availableTracklets.push_back(*tracklet);
+            shownSweeps.at(slot) = sweeps.points.at(slot);
+            sweepActors.at(slot)->setPointFrame(*shownSweeps.at(slot));
         }
     }
+
+    // The sweeps stay in world coordinates, VTK moves them into the current frame
+    Eigen::Affine3f worldToVelodyne = sweeps.pose.inverse().cast<float>();
+    for (int slot = 0; slot < sweepLoader->getNumberOfSweeps(); ++slot)
+    {
+        int sweepId = sweeps.frameIds.at(slot);
+        const KittiCloudActor::Ptr& actor = sweepActors.at(slot);
+        actor->setTransform(worldToVelodyne);
+        // The current sweep is the frame point cloud
+        actor->setVisible(sweepId >= 0 && (sweepId != frame_index || !pointCloudVisible));
+    }
+    ui->qvtkWidget_pclViewer->update();
+}
+
+void KittiVisualizerQt::hideAccumulatedSweeps()
+{
+    for (std::size_t slot = 0; slot < sweepActors.size(); ++slot)
+    {
+        sweepActors[slot]->setVisible(false);
+    }
+}
+
+KittiCloudActor::ColorMode KittiVisualizerQt::getSweepColorMode() const
+{
+    // The sweeps have no labels, and in world coordinates the range would
+    // be measured from the start of the drive
+    if (point_color_mode == KittiCloudActor::RANGE || point_color_mode == KittiCloudActor::LABEL)
+        return KittiCloudActor::INTENSITY;
+    return point_color_mode;
+}
+
+void KittiVisualizerQt::updateImageOverlay()
+{
+    KittiScopedTimer timer(stageTimes, "image overlay");
+    KittiCameraCalibration::ConstPtr calibration;
+    if (imageOverlayVisible && cameraVisible.at(OVERLAY_CAMERA))
+        calibration = dataset->getCameraCalibration();
+    if (!calibration)
+    {
+        QImage none;
+        imageWidgets.at(OVERLAY_CAMERA)->swapOverlay(none);
+        return;
+    }
+
+    const float* veloToImage = calibration->veloToImage[OVERLAY_CAMERA];
+    int width = calibration->imageWidth[OVERLAY_CAMERA];
+    int height = calibration->imageHeight[OVERLAY_CAMERA];
+    if (imageOverlay.width() != width || imageOverlay.height() != height)
+        imageOverlay = QImage(width, height, QImage::Format_ARGB32_Premultiplied);
+    imageOverlay.fill(0);
+
+    // Points as 2x2 pixels, written straight into the image
+    KittiProjectionKernel::project(*pointFrame, veloToImage, IMAGE_OVERLAY_MINIMUM_DEPTH,
+                                   width, height, projectedPoints);
+    std::size_t numberOfPoints = projectedPoints.size();
+    depthColors.resize(3 * numberOfPoints);
+    depthColorMap.map(projectedPoints.depth.data(), numberOfPoints, depthColors.data());
+    for (std::size_t i = 0; i < numberOfPoints; ++i)
+    {
+        int u = (int) projectedPoints.u[i];
+        int v = (int) projectedPoints.v[i];
+        const unsigned char* color = &depthColors[3 * i];
+        QRgb rgb = qRgb(color[0], color[1], color[2]);
+        int lastU = std::min(u + 1, width - 1);
+        for (int y = v; y <= std::min(v + 1, height - 1); ++y)
+        {
+            QRgb* line = reinterpret_cast<QRgb*>(imageOverlay.scanLine(y));
+            for (int x = u; x <= lastU; ++x)
+                line[x] = rgb;
+        }
+    }
+
+    if (trackletBoundingBoxesVisible && availableTracklets.size())
+    {
+        static const int edges[12][2] = {
+            {0, 1}, {1, 3}, {3, 2}, {2, 0},
+            {4, 5}, {5, 7}, {7, 6}, {6, 4},
+            {0, 4}, {1, 5}, {2, 6}, {3, 7}
+        };
+        Eigen::Matrix<float, 3, 4> projection;
+        for (int i = 0; i < 12; ++i)
+            projection(i / 4, i % 4) = veloToImage[i];
+
+        QPainter painter(&imageOverlay);
+        painter.setRenderHint(QPainter::Antialiasing);
+        for (int i = 0; i < availableTracklets.size(); ++i)
+        {
+            const KittiTracklet& tracklet = availableTracklets.at(i);
+            Eigen::Affine3f boxPose = getTrackletBoxPose(tracklet);
+            QPointF corners[8];
+            bool inFront = true;
+            for (int corner = 0; corner < 8 && inFront; ++corner)
+            {
+                Eigen::Vector3f unit((corner & 1) ? 0.5f : -0.5f,
+                                     (corner & 2) ? 0.5f : -0.5f,
+                                     (corner & 4) ? 0.5f : -0.5f);
+                Eigen::Vector3f pixel = projection * (boxPose * unit).homogeneous();
+                // Boxes reaching behind the camera would wrap around the image
+                inFront = pixel[2] >= IMAGE_OVERLAY_MINIMUM_DEPTH;
+                corners[corner] = QPointF(pixel[0] / pixel[2], pixel[1] / pixel[2]);
+            }
+            if (!inFront)
+                continue;
+
+            int r, g, b;
+            getTrackletColor(tracklet, r, g, b);
+            painter.setPen(QPen(QColor(r, g, b), 2.0));
+            for (int edge = 0; edge < 12; ++edge)
+                painter.drawLine(corners[edges[edge][0]], corners[edges[edge][1]]);
+        }
+    }
+
+    imageWidgets.at(OVERLAY_CAMERA)->swapOverlay(imageOverlay);
+}
+
+void KittiVisualizerQt::loadAvailableTracklets()
+{
+    KittiScopedTimer timer(stageTimes, "tracklet lookup");
+    availableTracklets = dataset->getActiveTracklets(frame_index);
 }
 
 void KittiVisualizerQt::clearAvailableTracklets()
 {
-    availableTracklets.clear();
+    availableTracklets = KittiActiveTracklets();
 }
 
 void KittiVisualizerQt::updateDatasetLabel()
@@ -435,7 +988,7 @@ void KittiVisualizerQt::updateDatasetLabel()
     std::stringstream text;
     text << "Data set: "
          << dataset_index + 1 << " of " << KittiConfig::availableDatasets.size()
-         << " [" << KittiConfig::getDatasetNumber(dataset_index) << "]"
+         << " [" << KittiConfig::getDatasetName(KittiConfig::getDatasetNumber(dataset_index)) << "]"
          << std::endl;
     ui->label_dataSet->setText(text.str().c_str());
 }
@@ -455,11 +1008,11 @@ void KittiVisualizerQt::updateTrackletLabel()
     if (availableTracklets.size())
     {
         std::stringstream text;
-        KittiTracklet tracklet = availableTracklets.at(tracklet_index);
+        const KittiTracklet& tracklet = availableTracklets.at(tracklet_index);
         text << "Tracklet: "
              << tracklet_index + 1 << " of " << availableTracklets.size()
              << " (\"" << tracklet.objectType
-             << "\", " << croppedTrackletPointClouds.at(tracklet_index).get()->size()
+             << "\", " << croppedTrackletPointFrames.at(tracklet_index)->size()
              << " points)"
              << std::endl;
         ui->label_tracklet->setText(text.str().c_str());
@@ -476,125 +1029,107 @@ void KittiVisualizerQt::updateTrackletLabel()
 
 void KittiVisualizerQt::showTrackletBoxes()
 {
-    double boxHeight = 0.0f;
-    double boxWidth = 0.0f;
-    double boxLength = 0.0f;
-    int pose_number = 0;
-
+    KittiScopedTimer timer(stageTimes, "show boxes");
+    trackletBoxActor->resize(availableTracklets.size());
     for (int i = 0; i < availableTracklets.size(); ++i)
     {
-        // Create the bounding box
         const KittiTracklet& tracklet = availableTracklets.at(i);
+        Eigen::Affine3f boxPose = getTrackletBoxPose(tracklet);
 
-        boxHeight = tracklet.h;
-        boxWidth = tracklet.w;
-        boxLength = tracklet.l;
-        pose_number = frame_index - tracklet.first_frame;
-        const Tracklets::tPose& tpose = tracklet.poses.at(pose_number);
-        Eigen::Vector3f boxTranslation;
-        boxTranslation[0] = (float) tpose.tx;
-        boxTranslation[1] = (float) tpose.ty;
-        boxTranslation[2] = (float) tpose.tz + (float) boxHeight / 2.0f;
-        Eigen::Quaternionf boxRotation = Eigen::Quaternionf(Eigen::AngleAxisf((float) tpose.rz, Eigen::Vector3f::UnitZ()));
-
-        // Add the bounding box to the visualizer
-        std::string viewer_id = "tracklet_box_" + i;
-        pclVisualizer->addCube(boxTranslation, boxRotation, boxLength, boxWidth, boxHeight, viewer_id);
+        // Color the bounding box by its object type, like the tracklet points
+        int r, g, b;
+        getTrackletColor(tracklet, r, g, b);
+        trackletBoxActor->setBox(i, boxPose, r, g, b);
     }
+    trackletBoxActor->update();
+    trackletBoxActor->setVisible(true);
+}
+
+Eigen::Affine3f KittiVisualizerQt::getTrackletBoxPose(const KittiTracklet& tracklet) const
+{
+    double boxHeight = tracklet.h;
+    double boxWidth = tracklet.w;
+    double boxLength = tracklet.l;
+    int pose_number = frame_index - tracklet.first_frame;
+    const Tracklets::tPose& tpose = tracklet.poses.at(pose_number);
+    Eigen::Vector3f boxTranslation;
+    boxTranslation[0] = (float) tpose.tx;
+    boxTranslation[1] = (float) tpose.ty;
+    boxTranslation[2] = (float) tpose.tz + (float) boxHeight / 2.0f;
+    Eigen::Quaternionf boxRotation = Eigen::Quaternionf(Eigen::AngleAxisf((float) tpose.rz, Eigen::Vector3f::UnitZ()));
+
+    return Eigen::Translation3f(boxTranslation)
+            * boxRotation
+            * Eigen::Scaling((float) boxLength, (float) boxWidth, (float) boxHeight);
 }
 
 void KittiVisualizerQt::hideTrackletBoxes()
 {
-    for (int i = 0; i < availableTracklets.size(); ++i)
-    {
-        std::string viewer_id = "tracklet_box_" + i;
-        pclVisualizer->removeShape(viewer_id);
-    }
+    trackletBoxActor->setVisible(false);
 }
 
 void KittiVisualizerQt::loadTrackletPoints()
 {
-    for (int i = 0; i < availableTracklets.size(); ++i)
-    {
-        // Create the tracklet point cloud
-        const KittiTracklet& tracklet = availableTracklets.at(i);
-        pcl::PointCloud<KittiPoint>::Ptr trackletPointCloud = dataset->getTrackletPointCloud(pointCloud, tracklet, frame_index);
-        pcl::PointCloud<KittiPoint>::Ptr trackletPointCloudTransformed(new pcl::PointCloud<KittiPoint>);
-
-        Eigen::Vector3f transformOffset;
-        transformOffset[0] = 0.0f;
-        transformOffset[1] = 0.0f;
-        transformOffset[2] = 6.0f;
-        pcl::transformPointCloud(*trackletPointCloud, *trackletPointCloudTransformed, transformOffset, Eigen::Quaternionf::Identity());
-
-        // Store the tracklet point cloud
-        croppedTrackletPointClouds.push_back(trackletPointCloudTransformed);
-    }
+    KittiScopedTimer timer(stageTimes, "tracklet points");
+    // Cropped and moved above the cloud by the prefetcher
+    croppedTrackletPointFrames = *frame->trackletPointFrames;
 }
 
 void KittiVisualizerQt::showTrackletPoints()
 {
+    KittiScopedTimer timer(stageTimes, "show tracklet clouds");
     for (int i = 0; i < availableTracklets.size(); ++i)
     {
-        // Create a color handler for the tracklet point cloud
+        if (i >= trackletPointActors.size())
+        {
+            vtkSmartPointer<vtkRenderer> renderer = pclVisualizer->getRendererCollection()->GetFirstRenderer();
+            trackletPointActors.push_back(KittiCloudActor::Ptr(new KittiCloudActor(renderer)));
+        }
+
+        // Color the tracklet point cloud by its object type
         const KittiTracklet& tracklet = availableTracklets.at(i);
         int r, g, b;
         getTrackletColor(tracklet, r, g, b);
-        KittiPointCloudColorHandlerCustom colorHandler(croppedTrackletPointClouds.at(i), r, g, b);
 
-        // Add tracklet point cloud to the visualizer
-        std::string viewer_id = "cropped_tracklet_" + i;
-        pclVisualizer->addPointCloud<KittiPoint>(croppedTrackletPointClouds.at(i), colorHandler, viewer_id);
+        const KittiCloudActor::Ptr& actor = trackletPointActors.at(i);
+        actor->setPointFrame(*croppedTrackletPointFrames.at(i));
+        actor->setColor(r, g, b);
+        actor->setVisible(true);
     }
 }
 
 void KittiVisualizerQt::hideTrackletPoints()
 {
-    for (int i = 0; i < availableTracklets.size(); ++i)
+    for (int i = 0; i < trackletPointActors.size(); ++i)
     {
-        std::string viewer_id = "cropped_tracklet_" + i;
-        pclVisualizer->removeShape(viewer_id);
+        trackletPointActors.at(i)->setVisible(false);
     }
 }
 
 void KittiVisualizerQt::clearTrackletPoints()
 {
-    croppedTrackletPointClouds.clear();
+    croppedTrackletPointFrames.clear();
 }
 
 void KittiVisualizerQt::showTrackletInCenter()
 {
+    KittiScopedTimer timer(stageTimes, "show centered tracklet");
     if (availableTracklets.size())
     {
-        // Create the centered tracklet point cloud
+        // The prefetcher found the points of the tracklet already, move just those into the box frame
         const KittiTracklet& tracklet = availableTracklets.at(tracklet_index);
-        pcl::PointCloud<KittiPoint>::Ptr cloudOut = dataset->getTrackletPointCloud(pointCloud, tracklet, frame_index);
-        pcl::PointCloud<KittiPoint>::Ptr cloudOutTransformed(new pcl::PointCloud<KittiPoint>);
-
-        int pose_number = frame_index - tracklet.first_frame;
-        Tracklets::tPose tpose = tracklet.poses.at(pose_number);
+        dataset->getTrackletPointFrame(*pointFrame, frame->trackletPointIndices->at(tracklet_index), tracklet,
+                                       frame_index, KittiBoxKernel::BOX_FRAME, Eigen::Vector3f::Zero(),
+                                       trackletInCenterFrame);
 
-        Eigen::Vector3f transformOffset((float) -(tpose.tx), (float) -(tpose.ty), (float) -(tpose.tz + tracklet.h / 2.0));
-
-        Eigen::AngleAxisf angleAxisZ(-tpose.rz, Eigen::Vector3f::UnitZ());
-        Eigen::Quaternionf transformRotation(angleAxisZ);
-        pcl::transformPointCloud(*cloudOut, *cloudOutTransformed, transformOffset, Eigen::Quaternionf::Identity());
-        pcl::transformPointCloud(*cloudOutTransformed, *cloudOut, Eigen::Vector3f::Zero(), transformRotation);
-
-        // Create color handler for the centered tracklet point cloud
-        KittiPointCloudColorHandlerCustom colorHandler(cloudOut, 0, 255, 0);
-
-        // Add the centered tracklet point cloud to the visualizer
-        pclVisualizer->addPointCloud<KittiPoint>(cloudOut, colorHandler, "centered_tracklet");
+        trackletInCenterActor->setPointFrame(trackletInCenterFrame);
+        trackletInCenterActor->setVisible(true);
     }
 }
 
 void KittiVisualizerQt::hideTrackletInCenter()
 {
-    if (availableTracklets.size())
-    {
-        pclVisualizer->removeShape("centered_tracklet");
-    }
+    trackletInCenterActor->setVisible(false);
 }
 
 void KittiVisualizerQt::setFrameNumber(int frameNumber)
@@ -618,6 +1153,137 @@ void KittiVisualizerQt::keyboardEventOccurred (const pcl::visualization::Keyboar
     }
 }
 
+void KittiVisualizerQt::playbackToggled(bool value)
+{
+    if (value)
+    {
+        if (frame_index >= dataset->getNumberOfFrames() - 1)
+            ui->slider_frame->setValue(0);
+
+        playbackStartFrame = frame_index;
+        playbackFramesDropped = 0;
+        playbackRateFrames = 0;
+        playbackAchievedFps = 0.0;
+        playbackFrameCost = 0.0;
+        playbackClock.start();
+        playbackRateClock.start();
+        playbackTimer->start();
+        ui->actionPlay->setText("Pause");
+    }
+    else
+    {
+        playbackTimer->stop();
+        ui->actionPlay->setText("Play");
+    }
+    updatePlaybackStatus();
+}
+
+void KittiVisualizerQt::playbackTimerTimeout()
+{
+    // Frames are scheduled against the wall clock. If loading and rendering a
+    // frame takes longer than the frame period, the frames that are overdue
+    // are skipped instead of letting the playback fall further behind.
+    int lastFrame = dataset->getNumberOfFrames() - 1;
+    int dueFrame = playbackStartFrame + (int) (playbackClock.elapsed() * playback_fps / 1000.0);
+    if (dueFrame < frame_index)
+    {
+        // The user moved the frame slider back, continue from there
+        playbackStartFrame = frame_index;
+        playbackClock.restart();
+        return;
+    }
+    if (dueFrame == frame_index)
+        return;
+    if (dueFrame > lastFrame)
+        dueFrame = lastFrame;
+
+    playbackFramesDropped += dueFrame - frame_index - 1;
+
+    QElapsedTimer frameTimer;
+    frameTimer.start();
+    ui->slider_frame->setValue(dueFrame);
+    playbackFrameCost = frameTimer.elapsed();
+    playbackRateFrames++;
+
+    if (playbackRateClock.elapsed() >= 1000)
+    {
+        playbackAchievedFps = playbackRateFrames * 1000.0 / playbackRateClock.restart();
+        playbackRateFrames = 0;
+        updatePlaybackStatus();
+    }
+
+    if (frame_index >= lastFrame)
+        ui->actionPlay->setChecked(false);
+}
+
+void KittiVisualizerQt::updatePlaybackStatus()
+{
+    if (!playbackTimer->isActive())
+    {
+        ui->statusBar->showMessage("Playback paused");
+        return;
+    }
+
+    std::stringstream text;
+    text.setf(std::ios::fixed);
+    text.precision(1);
+    text << "Playback: " << playbackAchievedFps << " of " << playback_fps << " fps, "
+         << playbackFramesDropped << " frames dropped, "
+         << playbackFrameCost << " ms per frame";
+    ui->statusBar->showMessage(text.str().c_str());
+}
+
+void KittiVisualizerQt::updateTimingLabel()
+{
+    // Limit the label updates, they are not free either
+    if (!timingLabel || !dataset || timingLabelClock.elapsed() < 250)
+        return;
+    timingLabelClock.restart();
+
+    // Buffers the data set pools had to create per frame since the last update
+    std::size_t bufferAllocations = dataset->getBufferAllocations();
+    if (framesStepped > framesSteppedAtLabel)
+    {
+        bufferAllocationsPerFrame = (double) (bufferAllocations - bufferAllocationsAtLabel)
+                / (framesStepped - framesSteppedAtLabel);
+        framesSteppedAtLabel = framesStepped;
+        bufferAllocationsAtLabel = bufferAllocations;
+    }
+
+    std::stringstream text;
+    text << stageTimes.toString() << " (p50/p95/max) | new buffers/frame: " << bufferAllocationsPerFrame;
+    timingLabel->setText(QString::fromStdString(text.str()));
+
+    if (!timing_csv_file.empty() && timingCsvClock.elapsed() >= 10000)
+    {
+        timingCsvClock.restart();
+        writeTimingCsv();
+    }
+}
+
+bool KittiVisualizerQt::writeTimingCsv()
+{
+    if (stageTimes.writeCsv(timing_csv_file))
+        return true;
+    std::cerr << "Could not write frame timing to " << timing_csv_file << "." << std::endl;
+    return false;
+}
+
+void KittiVisualizerQt::renderEventOccurred(vtkObject* caller, unsigned long eventId,
+                                            void* clientData, void* callData)
+{
+    KittiVisualizerQt* visualizer = static_cast<KittiVisualizerQt*>(clientData);
+    if (eventId == vtkCommand::StartEvent)
+    {
+        visualizer->renderClock.start();
+    }
+    else if (eventId == vtkCommand::EndEvent && visualizer->renderClock.isValid())
+    {
+        visualizer->stageTimes.add("render", visualizer->renderClock.nsecsElapsed() / 1.0e6);
+        visualizer->updateTimingLabel();
+    }
+}
+
 void KittiVisualizerQt::exitApplication(void)
 {
     QCoreApplication::exit();
@@ -19,9 +19,14 @@ limitations under the License.
 #ifndef QT_KITTI_VISUALIZER_H
 #define QT_KITTI_VISUALIZER_H
 
+#include <string>
 #include <vector>
 // Qt
+#include <QCheckBox>
+#include <QElapsedTimer>
+#include <QLabel>
 #include <QMainWindow>
+#include <QTimer>
 #include <QWidget>
 
 // Boost
@@ -32,9 +37,19 @@ limitations under the License.
 #include <pcl/visualization/pcl_visualizer.h>
 
 // VTK
+#include <vtkObject.h>
 #include <vtkRenderWindow.h>
 
+#include "KittiBoxActor.h"
+#include "KittiCloudActor.h"
+#include "KittiColorMap.h"
 #include "KittiDataset.h"
+#include "KittiFramePrefetcher.h"
+#include "KittiImage.h"
+#include "KittiImageCache.h"
+#include "KittiProjectionKernel.h"
+#include "KittiSweepLoader.h"
+#include "KittiTiming.h"
 
 #include <kitti-devkit-raw/tracklets.h>
 
@@ -57,6 +72,8 @@ public:
     bool loadPreviousFrame();
 
     void getTrackletColor(const KittiTracklet& tracklet, int &r, int& g, int& b);
+    /** Maps the unit cube centered at the origin onto the box of the tracklet in the current frame */
+    Eigen::Affine3f getTrackletBoxPose(const KittiTracklet& tracklet) const;
 
 public slots:
 
@@ -68,8 +85,20 @@ public slots:
     void showTrackletBoundingBoxesToggled(bool value);
     void showTrackletPointCloudsToggled(bool value);
     void showTrackletInCenterToggled(bool value);
+    void showAccumulatedSweepsToggled(bool value);
+    void showImageOverlayToggled(bool value);
+    void showCamerasToggled();
     void exitApplication(void);
     void camViewChanged(int index);
+    void colorModeChanged(int index);
+
+    void playbackToggled(bool value);
+    void playbackTimerTimeout();
+
+    void imageDecoded(int dataset, int camera, int frameId);
+    void sweepsLoaded(int dataset, int frameId);
+
+    void lodIdleTimeout();
 
 private:
 
@@ -82,42 +111,133 @@ private:
 
     int tracklet_index;
 
+    int prefetch_radius;
+    KittiFramePrefetcher* prefetcher;
+    /** Threads decoding a compressed archive frame, see KittiDataset::setDecodeThreads() */
+    int decode_threads;
+    KittiFrame::Ptr frame;
+    void loadFrame();
+
     pcl::visualization::PCLVisualizer::Ptr pclVisualizer;
 
     void loadAvailableTracklets();
     void clearAvailableTracklets();
-    std::vector<KittiTracklet> availableTracklets;
+    KittiActiveTracklets availableTracklets;
 
     void updateDatasetLabel();
     void updateFrameLabel();
     void updateTrackletLabel();
     void loadImageFile();
+    /** Caches the decoded images of each camera for the frames around the current one */
+    KittiImageCache* imageCache;
+    /** Indexed by camera, image_00 to image_03 */
+    std::vector<KittiImage*> imageWidgets;
+    std::vector<QCheckBox*> cameraCheckBoxes;
+    std::vector<bool> cameraVisible;
     void loadPointCloud();
     void showPointCloud();
     void hidePointCloud();
     bool pointCloudVisible;
-    KittiPointCloud::Ptr pointCloud;
+    KittiPointFrame::Ptr pointFrame;
+    KittiCloudActor::Ptr pointCloudActor;
+    KittiCloudActor::ColorMode point_color_mode;
+    /** Colors the labels of the full cloud, one per tracklet */
+    void updateLabelColors();
+
+    /** Leaf size of the voxel grid for the reduced cloud shown while the camera moves, 0 disables it */
+    float lod_leaf_size;
+    /** Whether the reduced cloud is shown instead of the full one */
+    bool pointCloudReduced;
+    KittiCloudActor::Ptr reducedPointCloudActor;
+    /** The frames the actors hold, so switching between them does not copy the points again */
+    KittiPointFrame::Ptr shownPointFrame;
+    KittiPointFrame::Ptr shownReducedPointFrame;
+    /** Shows the full cloud again once the camera stood still for a moment */
+    QTimer* lodIdleTimer;
+    static void interactionEventOccurred(vtkObject* caller, unsigned long eventId,
+                                         void* clientData, void* callData);
 
     void showTrackletBoxes();
     void hideTrackletBoxes();
     bool trackletBoundingBoxesVisible;
+    /** The edges of all tracklet boxes of the frame */
+    KittiBoxActor::Ptr trackletBoxActor;
 
     void loadTrackletPoints();
     void showTrackletPoints();
     void hideTrackletPoints();
     void clearTrackletPoints();
     bool trackletPointsVisible;
-    std::vector<KittiPointCloud::Ptr> croppedTrackletPointClouds;
+    std::vector<KittiPointFrame::Ptr> croppedTrackletPointFrames;
+    std::vector<KittiCloudActor::Ptr> trackletPointActors;
+
+    /** The previous sweeps, moved by the ego-motion into the current Velodyne frame */
+    void showAccumulatedSweeps();
+    void hideAccumulatedSweeps();
+    bool accumulatedSweepsVisible;
+    /** Number of sweeps accumulated, including the current one */
+    int accumulated_sweeps;
+    KittiSweepLoader* sweepLoader;
+    /** One actor per slot of the accumulator, refilled only when its sweep changes */
+    std::vector<KittiCloudActor::Ptr> sweepActors;
+    /** The sweep each actor shows */
+    std::vector<KittiPointFrame::ConstPtr> shownSweeps;
+    KittiCloudActor::ColorMode getSweepColorMode() const;
+
+    /** Draws the points and tracklet boxes of the frame, projected into the camera image, over the image */
+    void updateImageOverlay();
+    bool imageOverlayVisible;
+    /** Reused across frames, the image widget hands back the previous overlay */
+    QImage imageOverlay;
+    KittiProjectedPoints projectedPoints;
+    /** Colors the projected points by their depth */
+    KittiColorMap depthColorMap;
+    std::vector<unsigned char> depthColors;
 
     void showTrackletInCenter();
     void hideTrackletInCenter();
     bool trackletInCenterVisible;
+    KittiCloudActor::Ptr trackletInCenterActor;
+    /** Reused for the points of the centered tracklet */
+    KittiPointFrame trackletInCenterFrame;
 
     void setFrameNumber(int frameNumber);
 
+    /** Target playback rate in frames per second, the Velodyne spins at 10 Hz */
+    double playback_fps;
+    QTimer* playbackTimer;
+    /** Time since the playback was (re)anchored at playbackStartFrame */
+    QElapsedTimer playbackClock;
+    int playbackStartFrame;
+    int playbackFramesDropped;
+    /** Window for measuring the achieved playback rate */
+    QElapsedTimer playbackRateClock;
+    int playbackRateFrames;
+    double playbackAchievedFps;
+    double playbackFrameCost;
+    void updatePlaybackStatus();
+
     void keyboardEventOccurred (const pcl::visualization::KeyboardEvent &event,
                                 void* viewer_void);
 
+    /** Durations of the stages of a frame step, shown in the status bar */
+    KittiStageTimes stageTimes;
+    std::string timing_csv_file;
+    /** Time since the CSV file was last written; it is rewritten periodically so a crash keeps the samples */
+    QElapsedTimer timingCsvClock;
+    bool writeTimingCsv();
+    QLabel* timingLabel;
+    QElapsedTimer timingLabelClock;
+    /** Frame steps and pool buffer allocations, for the allocations per frame in the status bar */
+    int framesStepped;
+    int framesSteppedAtLabel;
+    std::size_t bufferAllocationsAtLabel;
+    double bufferAllocationsPerFrame;
+    QElapsedTimer renderClock;
+    void updateTimingLabel();
+    static void renderEventOccurred(vtkObject* caller, unsigned long eventId,
+                                    void* clientData, void* callData);
+
     Ui::KittiVisualizerQt *ui;
 };
 
@@ -0,0 +1,212 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+/*
+ * Checks that the vectorized box tests of KittiBoxKernel find exactly the
+ * points the scalar code finds, including points on the box faces, and that
+ * KittiBoxGrid finds the same points in one pass for all boxes.
+ */
+
+#define BOOST_TEST_MODULE KittiBoxKernel
+#include <boost/test/included/unit_test.hpp>
+
+#include <cmath>
+#include <vector>
+
+#include "KittiBoxGrid.h"
+#include "KittiBoxKernel.h"
+#include "KittiPointFrame.h"
+
+namespace
+{
+
+/** A fixed cloud: uniform points around the boxes plus points on their faces */
+void makeCloud(const std::vector<KittiYawBox>& boxes, KittiPointFrame& frame)
+{
+    frame.clear();
+    unsigned int state = 12345;
+    for (int i = 0; i < 20003; ++i)
+    {
+        float values[4];
+        for (int j = 0; j < 4; ++j)
+        {
+            state = state * 1664525u + 1013904223u;
+            values[j] = (state >> 8) / 16777216.0f;
+        }
+        frame.push_back(40.0f * values[0] - 20.0f, 40.0f * values[1] - 20.0f, 4.0f * values[2] - 2.0f, values[3]);
+    }
+    for (std::size_t b = 0; b < boxes.size(); ++b)
+    {
+        const KittiYawBox& box = boxes[b];
+        for (int corner = 0; corner < 8; ++corner)
+        {
+            float length = (corner & 1 ? 1.0f : -1.0f) * box.halfLength;
+            float width = (corner & 2 ? 1.0f : -1.0f) * box.halfWidth;
+            float height = (corner & 4 ? 1.0f : -1.0f) * box.halfHeight;
+            frame.push_back(box.centerX + box.cosYaw * length - box.sinYaw * width,
+                            box.centerY + box.sinYaw * length + box.cosYaw * width,
+                            box.centerZ + height, 0.5f);
+        }
+    }
+}
+
+std::vector<KittiOrientedBox> makeOrientedBoxes()
+{
+    std::vector<KittiOrientedBox> boxes;
+    const float yaws[] = { 0.0f, 0.3f, -1.2f, 3.14159265f, 1.5707963f };
+    for (int i = 0; i < 5; ++i)
+    {
+        boxes.push_back(KittiOrientedBox(Eigen::Vector3f(-10.0f + 5.0f * i, 3.0f - 2.0f * i, -0.5f + 0.25f * i),
+                                         Eigen::Vector3f(0.0f, 0.0f, yaws[i]),
+                                         Eigen::Vector3f(2.0f + 0.5f * i, 0.9f + 0.1f * i, 0.8f)));
+    }
+    return boxes;
+}
+
+std::vector<KittiYawBox> makeBoxes()
+{
+    std::vector<KittiOrientedBox> orientedBoxes = makeOrientedBoxes();
+    std::vector<KittiYawBox> boxes;
+    for (std::size_t i = 0; i < orientedBoxes.size(); ++i)
+    {
+        boxes.push_back(orientedBoxes[i].yawBox);
+    }
+    return boxes;
+}
+
+std::vector<KittiBoxKernel::InstructionSet> getSupportedInstructionSets()
+{
+    std::vector<KittiBoxKernel::InstructionSet> instructionSets;
+    const KittiBoxKernel::InstructionSet all[] = { KittiBoxKernel::SCALAR, KittiBoxKernel::SSE2, KittiBoxKernel::AVX2 };
+    for (int i = 0; i < 3; ++i)
+    {
+        if (KittiBoxKernel::isSupported(all[i]))
+            instructionSets.push_back(all[i]);
+    }
+    return instructionSets;
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(collect_matches_scalar)
+{
+    std::vector<KittiYawBox> boxes = makeBoxes();
+    KittiPointFrame frame;
+    makeCloud(boxes, frame);
+    std::vector<KittiBoxKernel::InstructionSet> instructionSets = getSupportedInstructionSets();
+    KittiBoxKernel::InstructionSet detected = KittiBoxKernel::getInstructionSet();
+
+    for (std::size_t b = 0; b < boxes.size(); ++b)
+    {
+        std::vector<int> expected;
+        BOOST_REQUIRE(KittiBoxKernel::setInstructionSet(KittiBoxKernel::SCALAR));
+        KittiBoxKernel::collect(frame.x(), frame.y(), frame.z(), frame.size(), boxes[b], expected);
+        // Some points inside, including the corners that are not lost to rounding
+        BOOST_CHECK(expected.size() > 8);
+
+        for (std::size_t s = 0; s < instructionSets.size(); ++s)
+        {
+            BOOST_TEST_CONTEXT(KittiBoxKernel::getInstructionSetName(instructionSets[s]) << ", box " << b)
+            {
+                std::vector<int> indices;
+                BOOST_REQUIRE(KittiBoxKernel::setInstructionSet(instructionSets[s]));
+                KittiBoxKernel::collect(frame.x(), frame.y(), frame.z(), frame.size(), boxes[b], indices);
+                BOOST_CHECK_EQUAL_COLLECTIONS(indices.begin(), indices.end(), expected.begin(), expected.end());
+            }
+        }
+    }
+    KittiBoxKernel::setInstructionSet(detected);
+}
+
+BOOST_AUTO_TEST_CASE(crop_matches_scalar)
+{
+    std::vector<KittiYawBox> boxes = makeBoxes();
+    KittiPointFrame frame;
+    makeCloud(boxes, frame);
+    std::vector<KittiBoxKernel::InstructionSet> instructionSets = getSupportedInstructionSets();
+    KittiBoxKernel::InstructionSet detected = KittiBoxKernel::getInstructionSet();
+    const KittiBoxKernel::OutputFrame outputFrames[] = { KittiBoxKernel::BOX_FRAME, KittiBoxKernel::POINT_FRAME };
+
+    for (std::size_t b = 0; b < boxes.size(); ++b)
+    {
+        for (int o = 0; o < 2; ++o)
+        {
+            KittiPointFrame expected;
+            std::vector<int> expectedIndices;
+            BOOST_REQUIRE(KittiBoxKernel::setInstructionSet(KittiBoxKernel::SCALAR));
+            KittiBoxKernel::crop(frame, boxes[b], outputFrames[o], 0.0f, 0.0f, 6.0f, expected, &expectedIndices);
+            BOOST_REQUIRE_EQUAL(expected.size(), expectedIndices.size());
+
+            for (std::size_t s = 0; s < instructionSets.size(); ++s)
+            {
+                BOOST_TEST_CONTEXT(KittiBoxKernel::getInstructionSetName(instructionSets[s]) << ", box " << b
+                                   << ", output frame " << o)
+                {
+                    KittiPointFrame cropped;
+                    std::vector<int> indices;
+                    BOOST_REQUIRE(KittiBoxKernel::setInstructionSet(instructionSets[s]));
+                    KittiBoxKernel::crop(frame, boxes[b], outputFrames[o], 0.0f, 0.0f, 6.0f, cropped, &indices);
+                    BOOST_CHECK_EQUAL_COLLECTIONS(indices.begin(), indices.end(),
+                                                  expectedIndices.begin(), expectedIndices.end());
+                    BOOST_REQUIRE_EQUAL(cropped.size(), expected.size());
+                    for (std::size_t i = 0; i < cropped.size(); ++i)
+                    {
+                        BOOST_CHECK_EQUAL(cropped.x()[i], expected.x()[i]);
+                        BOOST_CHECK_EQUAL(cropped.y()[i], expected.y()[i]);
+                        BOOST_CHECK_EQUAL(cropped.z()[i], expected.z()[i]);
+                        BOOST_CHECK_EQUAL(cropped.intensity()[i], expected.intensity()[i]);
+                    }
+                }
+            }
+        }
+    }
+    KittiBoxKernel::setInstructionSet(detected);
+}
+
+BOOST_AUTO_TEST_CASE(grid_matches_kernel)
+{
+    std::vector<KittiOrientedBox> orientedBoxes = makeOrientedBoxes();
+    std::vector<KittiYawBox> boxes = makeBoxes();
+    KittiPointFrame frame;
+    makeCloud(boxes, frame);
+    std::vector<KittiBoxKernel::InstructionSet> instructionSets = getSupportedInstructionSets();
+    KittiBoxKernel::InstructionSet detected = KittiBoxKernel::getInstructionSet();
+
+    KittiBoxGrid grid;
+    grid.setBoxes(orientedBoxes);
+    std::vector<std::vector<int> > gridIndices;
+    grid.collect(frame, gridIndices);
+    BOOST_REQUIRE_EQUAL(gridIndices.size(), boxes.size());
+
+    for (std::size_t b = 0; b < boxes.size(); ++b)
+    {
+        BOOST_CHECK(gridIndices[b].size() > 8);
+        for (std::size_t s = 0; s < instructionSets.size(); ++s)
+        {
+            BOOST_TEST_CONTEXT(KittiBoxKernel::getInstructionSetName(instructionSets[s]) << ", box " << b)
+            {
+                std::vector<int> indices;
+                BOOST_REQUIRE(KittiBoxKernel::setInstructionSet(instructionSets[s]));
+                KittiBoxKernel::collect(frame.x(), frame.y(), frame.z(), frame.size(), boxes[b], indices);
+                BOOST_CHECK_EQUAL_COLLECTIONS(indices.begin(), indices.end(),
+                                              gridIndices[b].begin(), gridIndices[b].end());
+            }
+        }
+    }
+    KittiBoxKernel::setInstructionSet(detected);
+}
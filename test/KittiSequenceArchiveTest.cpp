@@ -0,0 +1,248 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+/*
+ * Writes sequence archives and checks that the frames read back match the
+ * original points within the quantization step, and that compressed frames
+ * decode to exactly the points of plain ones.
+ */
+
+#define BOOST_TEST_MODULE KittiSequenceArchive
+#include <boost/test/included/unit_test.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include "KittiPointFrame.h"
+#include "KittiSequenceArchive.h"
+#include "KittiThreadPool.h"
+
+namespace
+{
+
+/** Points on rings like a Velodyne scan, so neighbors are close */
+void makeScan(int seed, std::size_t numberOfPoints, KittiPointFrame& frame)
+{
+    frame.clear();
+    unsigned int state = 777u + seed;
+    for (std::size_t i = 0; i < numberOfPoints; ++i)
+    {
+        state = state * 1664525u + 1013904223u;
+        float noise = (state >> 8) / 16777216.0f;
+        float angle = 0.0005f * (i % 12000);
+        float range = 5.0f + 0.8f * (i / 12000) + 0.2f * noise + seed;
+        frame.push_back(range * std::cos(angle), range * std::sin(angle), -1.7f + 0.1f * (i / 12000), noise);
+    }
+}
+
+/** A temporary folder that is removed with its contents */
+struct TemporaryDirectory
+{
+    TemporaryDirectory() :
+        path(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("kitti-test-%%%%-%%%%"))
+    {
+        boost::filesystem::create_directories(path);
+    }
+
+    ~TemporaryDirectory()
+    {
+        boost::system::error_code error;
+        boost::filesystem::remove_all(path, error);
+    }
+
+    boost::filesystem::path path;
+};
+
+/** The largest quantization error of a column, half a step of 1/65534 of its extent */
+float getTolerance(const float* values, std::size_t size)
+{
+    float minimum = *std::min_element(values, values + size);
+    float maximum = *std::max_element(values, values + size);
+    return 0.5f * (maximum - minimum) / 65534.0f * 1.01f + 1e-6f;
+}
+
+void checkClose(const KittiPointFrame& original, const KittiPointFrame& decoded)
+{
+    BOOST_REQUIRE_EQUAL(decoded.size(), original.size());
+    const float* originalColumns[3] = { original.x(), original.y(), original.z() };
+    const float* decodedColumns[3] = { decoded.x(), decoded.y(), decoded.z() };
+    for (int column = 0; column < 3; ++column)
+    {
+        float tolerance = getTolerance(originalColumns[column], original.size());
+        float error = 0.0f;
+        for (std::size_t i = 0; i < original.size(); ++i)
+            error = std::max(error, std::fabs(decodedColumns[column][i] - originalColumns[column][i]));
+        BOOST_CHECK_LE(error, tolerance);
+    }
+    float error = 0.0f;
+    for (std::size_t i = 0; i < original.size(); ++i)
+        error = std::max(error, std::fabs(decoded.intensity()[i] - original.intensity()[i]));
+    BOOST_CHECK_LE(error, 0.5f / 255.0f + 1e-6f);
+}
+
+}
+
+BOOST_AUTO_TEST_CASE(plain_round_trip)
+{
+    TemporaryDirectory directory;
+    boost::filesystem::path path = directory.path / "velodyne_points.kseq";
+
+    // Frame 1 is missing, frame 3 is empty
+    KittiPointFrame frames[4];
+    makeScan(0, 50000, frames[0]);
+    makeScan(2, 1234, frames[2]);
+
+    KittiSequenceArchiveWriter writer;
+    BOOST_REQUIRE(writer.open(path, 4));
+    BOOST_REQUIRE(writer.addFrame(0, frames[0]));
+    BOOST_REQUIRE(writer.addFrame(2, frames[2]));
+    BOOST_REQUIRE(writer.addFrame(3, frames[3]));
+    BOOST_REQUIRE(writer.close());
+    BOOST_CHECK_EQUAL(writer.getSize(), boost::filesystem::file_size(path));
+
+    KittiSequenceArchive archive;
+    BOOST_REQUIRE(archive.open(path));
+    BOOST_CHECK_EQUAL(archive.getNumberOfFrames(), 4);
+    BOOST_CHECK(archive.hasFrame(0));
+    BOOST_CHECK(!archive.hasFrame(1));
+    BOOST_CHECK(archive.hasFrame(2));
+    BOOST_CHECK(archive.hasFrame(3));
+    BOOST_CHECK(!archive.hasFrame(4));
+
+    KittiPointFrame decoded;
+    BOOST_REQUIRE(archive.readFrame(0, decoded));
+    checkClose(frames[0], decoded);
+    BOOST_CHECK(!archive.readFrame(1, decoded));
+    BOOST_CHECK(decoded.empty());
+    BOOST_REQUIRE(archive.readFrame(2, decoded));
+    checkClose(frames[2], decoded);
+    BOOST_REQUIRE(archive.readFrame(3, decoded));
+    BOOST_CHECK(decoded.empty());
+}
+
+BOOST_AUTO_TEST_CASE(damaged_archive_is_rejected)
+{
+    TemporaryDirectory directory;
+    boost::filesystem::path path = directory.path / "velodyne_points.kseq";
+
+    KittiPointFrame frame;
+    makeScan(0, 1000, frame);
+    KittiSequenceArchiveWriter writer;
+    BOOST_REQUIRE(writer.open(path, 1));
+    BOOST_REQUIRE(writer.addFrame(0, frame));
+    BOOST_REQUIRE(writer.close());
+
+    // Cut off the end of the only frame
+    boost::filesystem::resize_file(path, boost::filesystem::file_size(path) - 16);
+    KittiSequenceArchive archive;
+    BOOST_CHECK(!archive.open(path));
+}
+
+BOOST_AUTO_TEST_CASE(delta_varint_matches_plain)
+{
+    TemporaryDirectory directory;
+    boost::filesystem::path plainPath = directory.path / "plain.kseq";
+    boost::filesystem::path deltaPath = directory.path / "delta.kseq";
+
+    // Several chunks with a short last one, a chunk of one point, and an empty frame
+    KittiPointFrame frames[4];
+    makeScan(0, 50000, frames[0]);
+    makeScan(1, 16385, frames[1]);
+    makeScan(2, 300, frames[2]);
+
+    KittiSequenceArchiveWriter plainWriter;
+    KittiSequenceArchiveWriter deltaWriter;
+    BOOST_REQUIRE(plainWriter.open(plainPath, 4));
+    BOOST_REQUIRE(deltaWriter.open(deltaPath, 4, KittiSequenceArchive::DELTA_VARINT));
+    for (int frameId = 0; frameId < 4; ++frameId)
+    {
+        BOOST_REQUIRE(plainWriter.addFrame(frameId, frames[frameId]));
+        BOOST_REQUIRE(deltaWriter.addFrame(frameId, frames[frameId]));
+    }
+    BOOST_REQUIRE(plainWriter.close());
+    BOOST_REQUIRE(deltaWriter.close());
+    BOOST_CHECK_LT(deltaWriter.getSize(), plainWriter.getSize());
+
+    KittiSequenceArchive plainArchive;
+    KittiSequenceArchive deltaArchive;
+    BOOST_REQUIRE(plainArchive.open(plainPath));
+    BOOST_REQUIRE(deltaArchive.open(deltaPath));
+    KittiThreadPool decodePool(4);
+    for (int frameId = 0; frameId < 4; ++frameId)
+    {
+        KittiPointFrame plain, delta, pooledDelta;
+        BOOST_REQUIRE(plainArchive.readFrame(frameId, plain));
+        BOOST_REQUIRE(deltaArchive.readFrame(frameId, delta));
+        BOOST_REQUIRE(deltaArchive.readFrame(frameId, pooledDelta, &decodePool));
+        BOOST_REQUIRE_EQUAL(delta.size(), plain.size());
+        BOOST_REQUIRE_EQUAL(pooledDelta.size(), plain.size());
+
+        // Bit for bit, not just within the quantization step
+        std::size_t bytes = plain.size() * sizeof(float);
+        const float* plainColumns[4] = { plain.x(), plain.y(), plain.z(), plain.intensity() };
+        const float* deltaColumns[4] = { delta.x(), delta.y(), delta.z(), delta.intensity() };
+        const float* pooledColumns[4] = { pooledDelta.x(), pooledDelta.y(), pooledDelta.z(), pooledDelta.intensity() };
+        for (int column = 0; column < 4 && bytes > 0; ++column)
+        {
+            BOOST_CHECK(std::memcmp(deltaColumns[column], plainColumns[column], bytes) == 0);
+            BOOST_CHECK(std::memcmp(pooledColumns[column], plainColumns[column], bytes) == 0);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(damaged_point_count_is_rejected)
+{
+    TemporaryDirectory directory;
+    boost::filesystem::path path = directory.path / "velodyne_points.kseq";
+
+    KittiPointFrame frame;
+    makeScan(0, 1000, frame);
+    KittiSequenceArchiveWriter writer;
+    BOOST_REQUIRE(writer.open(path, 1, KittiSequenceArchive::DELTA_VARINT));
+    BOOST_REQUIRE(writer.addFrame(0, frame));
+    BOOST_REQUIRE(writer.close());
+
+    // Header, two offsets, then the frame: origin, step, number of points,
+    // encoding, chunk size. A huge chunk size keeps the four streams of one
+    // chunk for almost 2^32 points.
+    const std::streamoff frameOffset = 16 + 2 * 8;
+    std::fstream file(path.string().c_str(), std::ios::in | std::ios::out | std::ios::binary);
+    boost::uint32_t encoding = 0;
+    file.seekg(frameOffset + 28);
+    file.read(reinterpret_cast<char*>(&encoding), sizeof(encoding));
+    BOOST_REQUIRE_EQUAL(encoding, (boost::uint32_t) KittiSequenceArchive::DELTA_VARINT);
+    const boost::uint32_t numberOfPoints = 0xfffffff0u;
+    const boost::uint32_t chunkSize = 0xffffffffu;
+    file.seekp(frameOffset + 24);
+    file.write(reinterpret_cast<const char*>(&numberOfPoints), sizeof(numberOfPoints));
+    file.seekp(frameOffset + 32);
+    file.write(reinterpret_cast<const char*>(&chunkSize), sizeof(chunkSize));
+    file.close();
+
+    KittiSequenceArchive archive;
+    BOOST_REQUIRE(archive.open(path));
+    KittiPointFrame decoded;
+    BOOST_CHECK(!archive.readFrame(0, decoded));
+    BOOST_CHECK(decoded.empty());
+}
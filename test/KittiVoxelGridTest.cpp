@@ -0,0 +1,88 @@
+/*
+
+Copyright 2016 Mark Muth
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+
+*/
+
+/*
+ * Checks the centroids and the point order of KittiVoxelGrid.
+ */
+
+#define BOOST_TEST_MODULE KittiVoxelGrid
+#include <boost/test/included/unit_test.hpp>
+
+#include "KittiPointFrame.h"
+#include "KittiVoxelGrid.h"
+
+BOOST_AUTO_TEST_CASE(centroids_in_first_seen_order)
+{
+    KittiPointFrame input;
+    input.push_back(0.25f, 0.25f, 0.25f, 0.2f);
+    input.push_back(-0.5f, 0.5f, 0.5f, 1.0f);
+    input.push_back(0.75f, 0.75f, 0.75f, 0.4f);
+    // Negative coordinates round down, so this is not in the voxel of the first point
+    input.push_back(-0.25f, 0.25f, 0.25f, 0.0f);
+    input.push_back(2.5f, 0.5f, 0.5f, 0.6f);
+
+    KittiVoxelGrid voxelGrid(1.0f);
+    KittiPointFrame output;
+    voxelGrid.filter(input, output);
+
+    BOOST_REQUIRE_EQUAL(output.size(), 3u);
+    BOOST_CHECK_CLOSE(output.x()[0], 0.5f, 1e-4);
+    BOOST_CHECK_CLOSE(output.y()[0], 0.5f, 1e-4);
+    BOOST_CHECK_CLOSE(output.z()[0], 0.5f, 1e-4);
+    BOOST_CHECK_CLOSE(output.intensity()[0], 0.3f, 1e-4);
+    BOOST_CHECK_CLOSE(output.x()[1], -0.375f, 1e-4);
+    BOOST_CHECK_CLOSE(output.intensity()[1], 0.5f, 1e-4);
+    BOOST_CHECK_CLOSE(output.x()[2], 2.5f, 1e-4);
+    BOOST_CHECK_CLOSE(output.intensity()[2], 0.6f, 1e-4);
+}
+
+BOOST_AUTO_TEST_CASE(reused_grid_forgets_previous_frame)
+{
+    KittiVoxelGrid voxelGrid(0.5f);
+    KittiPointFrame input;
+    KittiPointFrame output;
+    for (int i = 0; i < 1000; ++i)
+        input.push_back(0.01f * i, 0.0f, 0.0f, 1.0f);
+    voxelGrid.filter(input, output);
+    BOOST_CHECK_EQUAL(output.size(), 20u);
+
+    input.clear();
+    input.push_back(0.1f, 0.1f, 0.1f, 0.5f);
+    voxelGrid.filter(input, output);
+    BOOST_REQUIRE_EQUAL(output.size(), 1u);
+    BOOST_CHECK_CLOSE(output.x()[0], 0.1f, 1e-4);
+    BOOST_CHECK_CLOSE(output.intensity()[0], 0.5f, 1e-4);
+}
+
+BOOST_AUTO_TEST_CASE(zero_leaf_size_copies)
+{
+    KittiPointFrame input;
+    input.push_back(1.0f, 2.0f, 3.0f, 0.5f);
+    input.push_back(1.0f, 2.0f, 3.0f, 0.25f);
+
+    KittiVoxelGrid voxelGrid(0.0f);
+    KittiPointFrame output;
+    voxelGrid.filter(input, output);
+    BOOST_REQUIRE_EQUAL(output.size(), 2u);
+    BOOST_CHECK_EQUAL(output.intensity()[0], 0.5f);
+    BOOST_CHECK_EQUAL(output.intensity()[1], 0.25f);
+
+    KittiPointFrame empty;
+    voxelGrid.filter(empty, output);
+    BOOST_CHECK(output.empty());
+}